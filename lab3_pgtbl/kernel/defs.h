@@ -67,6 +67,7 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+uint64          kfreepages(void);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -93,6 +94,7 @@ int             growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
+void            usyscallupdate(struct proc*);
 int             kill(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
@@ -151,6 +153,7 @@ void            syscall();
 
 // trap.c
 extern uint     ticks;
+extern uint64   boottime;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
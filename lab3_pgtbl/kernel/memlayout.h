@@ -65,7 +65,18 @@
 #ifdef LAB_PGTBL
 #define USYSCALL (TRAPFRAME - PGSIZE)
 
+// The kernel rewrites the fields after seq each time the
+// process returns to user space. A timer interrupt can do so
+// in the middle of a user read, so readers use seq as a
+// seqlock: read it, then the fields, and start again if seq
+// was odd or has since changed (see user/ulib.c).
 struct usyscall {
-  int pid;  // Process ID
+  int pid;          // Process ID
+  uint seq;         // Odd while the fields below are changing
+  uint ticks;       // Clock ticks since boot, as from uptime()
+  int cpu;          // CPU the process last ran on
+  uint64 freepages; // Free physical pages
+  uint64 timebase;  // time CSR at boot
+  uint64 timefreq;  // time CSR units per second
 };
 #endif
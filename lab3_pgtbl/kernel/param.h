@@ -12,4 +12,9 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+// time CSR units per second: the timebase-frequency of /cpus in
+// the device tree, which qemu's virt machine sets to 10MHz.
+// The kernel hands it to user space in struct usyscall, for
+// uclock().
+#define TIMEFREQ     10000000
 
@@ -138,7 +138,12 @@ found:
     release(&p->lock);
     return 0;
   }
+  // kalloc() fills the page with junk; seq must start even,
+  // or usyscall() readers wait for an update forever.
+  memset(p->usyscall, 0, PGSIZE);
   p->usyscall->pid = p->pid;
+  p->usyscall->timebase = boottime;
+  p->usyscall->timefreq = TIMEFREQ;
 
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
@@ -232,6 +237,22 @@ proc_pagetable(struct proc *p)
   return pagetable;
 }
 
+// Bring p's USYSCALL page up to date, as p returns to
+// user space. Called with interrupts off.
+void
+usyscallupdate(struct proc *p)
+{
+  struct usyscall *u = p->usyscall;
+
+  u->seq++;
+  __sync_synchronize();
+  u->ticks = ticks;
+  u->cpu = cpuid();
+  u->freepages = kfreepages();
+  __sync_synchronize();
+  u->seq++;
+}
+
 // Free a process's page table, and free the
 // physical memory it refers to.
 void
@@ -8,6 +8,7 @@
 
 struct spinlock tickslock;
 uint ticks;
+uint64 boottime;   // r_time() when trapinit() ran
 
 extern char trampoline[], uservec[], userret[];
 
@@ -20,6 +21,7 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  boottime = r_time();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -27,6 +29,10 @@ void
 trapinithart(void)
 {
   w_stvec((uint64)kernelvec);
+#ifdef LAB_PGTBL
+  // let user code read the time CSR, for uclock().
+  w_scounteren(r_scounteren() | 2);
+#endif
 }
 
 //
@@ -122,6 +128,10 @@ usertrapret(void)
   // tell trampoline.S the user page table to switch to.
   uint64 satp = MAKE_SATP(p->pagetable);
 
+#ifdef LAB_PGTBL
+  usyscallupdate(p);
+#endif
+
   // jump to userret in trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
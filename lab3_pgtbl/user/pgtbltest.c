@@ -9,6 +9,7 @@
 void print_pgtbl();
 void print_kpgtbl();
 void ugetpid_test();
+void usyscall_test();
 void superpg_test();
 
 int
@@ -16,6 +17,7 @@ main(int argc, char *argv[])
 {
   print_pgtbl();
   ugetpid_test();
+  usyscall_test();
   print_kpgtbl();
   superpg_test();
   printf("pgtbltest: all tests succeeded\n");
@@ -75,6 +77,40 @@ ugetpid_test()
   printf("ugetpid_test: OK\n");
 }
 
+void
+usyscall_test()
+{
+  uint64 t0, t1, free;
+  int u;
+
+  printf("usyscall_test starting\n");
+  testname = "usyscall_test";
+
+  u = uptime();
+  if (uuptime() < u || uuptime() > u + 1)
+    err("uuptime() disagrees with uptime()");
+  if (ucpu() < 0 || ucpu() >= NCPU)
+    err("bad cpu");
+
+  t0 = uclock();
+  sleep(2);
+  t1 = uclock();
+  if (t1 <= t0)
+    err("clock did not advance");
+  if (uuptime() < u + 2)
+    err("ticks did not advance");
+
+  free = ufreepages();
+  if (free == 0)
+    err("no free pages");
+  if (sbrk(10 * PGSIZE) == (char *)-1)
+    err("sbrk failed");
+  if (ufreepages() > free - 10)
+    err("free pages not updated");
+  sbrk(-10 * PGSIZE);
+  printf("usyscall_test: OK\n");
+}
+
 void
 print_kpgtbl()
 {
@@ -158,4 +158,68 @@ ugetpid(void)
   struct usyscall *u = (struct usyscall *)USYSCALL;
   return u->pid;
 }
+
+// Copy the USYSCALL page, retrying until the kernel has
+// not changed it while we read.
+static void
+usyscall(struct usyscall *c)
+{
+  volatile struct usyscall *u = (struct usyscall *)USYSCALL;
+  uint seq;
+
+  do {
+    while((seq = u->seq) & 1)
+      ;
+    __sync_synchronize();
+    c->ticks = u->ticks;
+    c->cpu = u->cpu;
+    c->freepages = u->freepages;
+    c->timebase = u->timebase;
+    c->timefreq = u->timefreq;
+    __sync_synchronize();
+  } while(u->seq != seq);
+}
+
+// Clock ticks since boot, like uptime(), without a system call.
+int
+uuptime(void)
+{
+  struct usyscall c;
+
+  usyscall(&c);
+  return c.ticks;
+}
+
+// The CPU this process last ran on, as of its last trap.
+int
+ucpu(void)
+{
+  struct usyscall c;
+
+  usyscall(&c);
+  return c.cpu;
+}
+
+// Free physical pages, as of this process's last trap.
+uint64
+ufreepages(void)
+{
+  struct usyscall c;
+
+  usyscall(&c);
+  return c.freepages;
+}
+
+// Nanoseconds since boot, from the time CSR.
+uint64
+uclock(void)
+{
+  struct usyscall c;
+  uint64 t;
+
+  usyscall(&c);
+  asm volatile("rdtime %0" : "=r" (t));
+  t -= c.timebase;
+  return t / c.timefreq * 1000000000 + t % c.timefreq * 1000000000 / c.timefreq;
+}
 #endif
@@ -34,6 +34,10 @@ int recv(uint32, uint32*, uint32*, char *, uint32);
 #endif
 #ifdef LAB_PGTBL
 int ugetpid(void);
+int uuptime(void);
+int ucpu(void);
+uint64 ufreepages(void);
+uint64 uclock(void);
 uint64 pgpte(void*);
 void kpgtbl(void);
 #endif
@@ -89,6 +89,7 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+struct proc*    kproc(struct proc*, void (*)(void), char*);
 int             growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
@@ -148,6 +149,7 @@ void            argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+uint64          syscallv(int, uint64*);
 
 // trap.c
 extern uint     ticks;
@@ -163,6 +165,10 @@ void            uartputc(int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
+// uring.c
+void            uringfree(struct proc*);
+int             uringbusy(struct proc*, uint64, uint64);
+
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
@@ -121,6 +121,8 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  if(p->uring)
+    uringfree(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
@@ -58,10 +58,12 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   URING (ring_enter()'s rings, if used)
 //   USYSCALL (shared with kernel)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define URING (TRAPFRAME - 2*PGSIZE)
 #ifdef LAB_PGTBL
 #define USYSCALL (TRAPFRAME - PGSIZE)
 
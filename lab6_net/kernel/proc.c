@@ -161,6 +161,7 @@ freeproc(struct proc *p)
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  p->uring = 0;
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -210,8 +211,13 @@ proc_pagetable(struct proc *p)
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
+  pte_t *pte;
+
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  // the rings, if ring_enter() mapped them.
+  if((pte = walk(pagetable, URING, 0)) != 0 && (*pte & PTE_V))
+    uvmunmap(pagetable, URING, 1, 1);
   uvmfree(pagetable, sz);
 }
 
@@ -268,6 +274,9 @@ growproc(int n)
       return -1;
     }
   } else if(n < 0){
+    // a ring worker may be copying to pages about to go.
+    if(p->uring && uringbusy(p, PGROUNDUP(sz + n), PGROUNDUP(sz)))
+      return -1;
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
   p->sz = sz;
@@ -325,6 +334,39 @@ fork(void)
   return pid;
 }
 
+// Make a process that runs fn in the kernel, never
+// returning to user space, and works in p's address
+// space, which it must stop using (setting its own
+// pagetable to 0) before p frees it. It ends with exit(),
+// and init reaps it. fn starts holding the new proc's lock,
+// as forkret() does.
+// Returns the new proc with its lock held, for the caller
+// to finish setting up and make RUNNABLE, or 0.
+struct proc*
+kproc(struct proc *p, void (*fn)(void), char *name)
+{
+  struct proc *np;
+
+  if((np = allocproc()) == 0)
+    return 0;
+
+  // np never needs its own page table.
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = p->pagetable;
+  np->sz = p->sz;
+  np->cwd = idup(p->cwd);
+  safestrcpy(np->name, name, sizeof(np->name));
+  np->context.ra = (uint64)fn;
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = initproc;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  return np;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -351,6 +393,10 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // stop the ring worker, if any, before anything it uses goes.
+  if(p->uring)
+    uringfree(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
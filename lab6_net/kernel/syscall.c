@@ -102,6 +102,8 @@ extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 
+extern uint64 sys_ring_enter(void);
+
 #ifdef LAB_NET
 extern uint64 sys_bind(void);
 extern uint64 sys_unbind(void);
@@ -137,6 +139,7 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_ring_enter] sys_ring_enter,
 #ifdef LAB_NET
 [SYS_bind] sys_bind,
 [SYS_unbind] sys_unbind,
@@ -150,6 +153,36 @@ static uint64 (*syscalls[])(void) = {
 };
 
 
+// Run system call num with the given arguments, as though
+// the current process had made it, for ring_enter().
+// Returns -1 if there is no such system call.
+uint64
+syscallv(int num, uint64 *args)
+{
+  struct trapframe *tf = myproc()->trapframe;
+  uint64 saved[5], r;
+
+  if(num <= 0 || num >= NELEM(syscalls) || syscalls[num] == 0)
+    return -1;
+  // the arg*() functions read arguments from the trapframe.
+  saved[0] = tf->a0;
+  saved[1] = tf->a1;
+  saved[2] = tf->a2;
+  saved[3] = tf->a3;
+  saved[4] = tf->a4;
+  tf->a0 = args[0];
+  tf->a1 = args[1];
+  tf->a2 = args[2];
+  tf->a3 = args[3];
+  tf->a4 = args[4];
+  r = syscalls[num]();
+  tf->a0 = saved[0];
+  tf->a1 = saved[1];
+  tf->a2 = saved[2];
+  tf->a3 = saved[3];
+  tf->a4 = saved[4];
+  return r;
+}
 
 void
 syscall(void)
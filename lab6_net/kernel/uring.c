@@ -0,0 +1,388 @@
+// Batched, asynchronous system calls.
+//
+// A process's first ring_enter() maps a page at URING that
+// holds a ring of submissions, each naming a system call and
+// its arguments, and a ring of completions with their results
+// (see uring.h). It also starts two workers: kernel-only
+// processes (see kproc()) that work in the process's address
+// space. The process queues submissions in the page and then
+// calls ring_enter(n, wait), which takes up to n of them in
+// one trap and hands them to the workers, waiting for no more
+// than wait completions. The workers run them and post each
+// result, so the process's I/O overlaps its work.
+//
+// One worker does I/O that finishes on its own: reads and
+// writes of files on disk, and send(). The other does what
+// may wait on someone else indefinitely: pipe and console
+// reads and writes, and recv(). So a recv() with no packet in
+// sight holds up only the requests queued behind it on the
+// second worker. Each worker runs its requests in submission
+// order, and so completes them in that order; between the two
+// there is no order.
+//
+// open() and close() change the descriptor table, which only
+// the process itself uses, so ring_enter() runs them at once.
+// For read() and write(), ring_enter() takes a reference to
+// the file as it hands them over, so that the worker's I/O is
+// unaffected by a later close() of the descriptor.
+//
+// Completions can thus arrive out of order; the data field
+// of each tells which submission it belongs to. Requests still
+// queued or running when the process exits or execs are
+// abandoned.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "syscall.h"
+#include "uring.h"
+#include "defs.h"
+
+#define UDISK 0             // worker for I/O that finishes on its own
+#define UWAIT 1             // worker for I/O that may wait indefinitely
+#define NUWORKER 2
+
+// A submission handed to a worker.
+struct uringreq {
+  int op;
+  int busy;                 // queued or running
+  uint64 data;
+  uint64 args[5];
+  struct file *f;           // for read and write, the file of args[0]
+};
+
+// A worker and the requests queued for it, by index in
+// uringctx.req[].
+struct uringworker {
+  struct proc *proc;        // 0 once the worker has quit
+  uchar q[URING_ENTRIES];
+  uint qhead;
+  uint qtail;
+};
+
+// The kernel's side of a process's rings. The shared page
+// is the process's to scribble on, so the kernel keeps its
+// own copies of the counts it advances.
+struct uringctx {
+  struct spinlock lock;
+  struct uring *r;          // the page mapped at URING
+  uint sqhead;              // next submission to take
+  uint cqtail;              // next completion to post
+  int inflight;             // completions still owed, at most URING_ENTRIES
+  int stop;                 // workers should quit
+  struct uringreq req[URING_ENTRIES];
+  struct uringworker w[NUWORKER];
+};
+
+// Post a completion. Caller holds ctx->lock.
+static void
+uringpost(struct uringctx *ctx, uint64 data, int res)
+{
+  struct uring_cqe *cqe = &ctx->r->cq[ctx->cqtail % URING_ENTRIES];
+
+  cqe->data = data;
+  cqe->res = res;
+  // the process must see the entry before the new tail.
+  __sync_synchronize();
+  ctx->r->cqtail = ++ctx->cqtail;
+}
+
+// Run a request handed over by ring_enter(), as a worker.
+static int
+uringrun(struct uringreq *req)
+{
+  int res;
+
+  switch(req->op){
+  case SYS_read:
+    res = fileread(req->f, req->args[1], req->args[2]);
+    fileclose(req->f);
+    return res;
+  case SYS_write:
+    res = filewrite(req->f, req->args[1], req->args[2]);
+    fileclose(req->f);
+    return res;
+  }
+  return syscallv(req->op, req->args);
+}
+
+// Does [a, a+n) overlap [lo, hi)?
+static int
+overlaps(uint64 a, uint64 n, uint64 lo, uint64 hi)
+{
+  return n > 0 && a < hi && (a + n > lo || a + n < a);
+}
+
+// Might req copy to or from user memory in [lo, hi)?
+static int
+uringtouches(struct uringreq *req, uint64 lo, uint64 hi)
+{
+  switch(req->op){
+  case SYS_read:
+  case SYS_write:
+    return overlaps(req->args[1], (uint)req->args[2], lo, hi);
+#ifdef LAB_NET
+  case SYS_send:
+    return overlaps(req->args[3], (uint)req->args[4], lo, hi);
+  case SYS_recv:
+    return overlaps(req->args[1], sizeof(int), lo, hi) ||
+      overlaps(req->args[2], sizeof(short), lo, hi) ||
+      overlaps(req->args[3], (uint)req->args[4], lo, hi);
+#endif
+  }
+  return 0;
+}
+
+// A worker's loop: run the requests queued for it until
+// told to stop.
+static void
+uringwork(void)
+{
+  struct proc *p = myproc();
+  struct uringctx *ctx = p->uring;
+  struct uringworker *w;
+  struct uringreq req;
+  int i, res;
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+
+  acquire(&ctx->lock);
+  for(w = ctx->w; w->proc != p; w++)
+    ;
+  for(;;){
+    while(w->qhead == w->qtail && !ctx->stop)
+      sleep(ctx, &ctx->lock);
+    if(ctx->stop)
+      break;
+    i = w->q[w->qhead++ % URING_ENTRIES];
+    req = ctx->req[i];
+    release(&ctx->lock);
+
+    res = uringrun(&req);
+
+    acquire(&ctx->lock);
+    uringpost(ctx, req.data, res);
+    ctx->req[i].busy = 0;
+    ctx->inflight--;
+    wakeup(ctx);
+  }
+  release(&ctx->lock);
+
+  // drop requests never run. the process is waiting in
+  // uringfree(), and won't queue more.
+  for(; w->qhead != w->qtail; w->qhead++){
+    i = w->q[w->qhead % URING_ENTRIES];
+    if(ctx->req[i].f)
+      fileclose(ctx->req[i].f);
+  }
+
+  // the process's page table and ctx are not ours to free.
+  p->pagetable = 0;
+  p->uring = 0;
+  acquire(&ctx->lock);
+  w->proc = 0;
+  wakeup(ctx);
+  release(&ctx->lock);
+  exit(0);
+}
+
+// Map a zeroed ring page at URING in p's page table, and
+// start its workers.
+static int
+uringsetup(struct proc *p)
+{
+  struct uringctx *ctx;
+  struct proc *np;
+  char *mem;
+  int i;
+
+  if((ctx = (struct uringctx*)kalloc()) == 0)
+    return -1;
+  memset(ctx, 0, PGSIZE);
+  initlock(&ctx->lock, "uring");
+  if((mem = kalloc()) == 0){
+    kfree(ctx);
+    return -1;
+  }
+  memset(mem, 0, PGSIZE);
+  if(mappages(p->pagetable, URING, PGSIZE, (uint64)mem, PTE_R | PTE_W | PTE_U) < 0){
+    kfree(mem);
+    kfree(ctx);
+    return -1;
+  }
+  ctx->r = (struct uring*)mem;
+  p->uring = ctx;
+
+  for(i = 0; i < NUWORKER; i++){
+    if((np = kproc(p, uringwork, "uring")) == 0){
+      // stops the workers started so far.
+      uringfree(p);
+      uvmunmap(p->pagetable, URING, 1, 1);
+      return -1;
+    }
+    np->uring = ctx;
+    ctx->w[i].proc = np;
+    np->state = RUNNABLE;
+    release(&np->lock);
+  }
+  return 0;
+}
+
+// Start submission sqe: run it now if it changes the
+// descriptor table, or else queue it for a worker.
+static void
+uringstart(struct proc *p, struct uringctx *ctx, struct uring_sqe *sqe)
+{
+  struct uringworker *w;
+  struct uringreq req;
+  int fd, i, res;
+
+  req.op = sqe->op;
+  req.busy = 1;
+  req.data = sqe->data;
+  memmove(req.args, sqe->args, sizeof(req.args));
+  req.f = 0;
+
+  switch(sqe->op){
+  case SYS_open:
+  case SYS_close:
+    res = syscallv(sqe->op, req.args);
+    goto post;
+  case SYS_read:
+  case SYS_write:
+    fd = req.args[0];
+    if(fd < 0 || fd >= NOFILE || p->ofile[fd] == 0){
+      res = -1;
+      goto post;
+    }
+    req.f = filedup(p->ofile[fd]);
+    w = &ctx->w[req.f->type == FD_INODE ? UDISK : UWAIT];
+    break;
+#ifdef LAB_NET
+  case SYS_send:
+    w = &ctx->w[UDISK];
+    break;
+  case SYS_recv:
+    w = &ctx->w[UWAIT];
+    break;
+#endif
+  default:
+    res = -1;
+    goto post;
+  }
+
+  acquire(&ctx->lock);
+  // ring_enter() keeps inflight below URING_ENTRIES,
+  // so there is a free slot.
+  for(i = 0; ctx->req[i].busy; i++)
+    ;
+  ctx->req[i] = req;
+  w->q[w->qtail++ % URING_ENTRIES] = i;
+  ctx->inflight++;
+  wakeup(ctx);
+  release(&ctx->lock);
+  return;
+
+post:
+  acquire(&ctx->lock);
+  uringpost(ctx, req.data, res);
+  release(&ctx->lock);
+}
+
+// Take up to n queued submissions, stopping early if the
+// completion ring could overflow. Then wait until at least
+// wait completions are posted, or none are still owed.
+// The first call maps the rings, so it finds them empty.
+// Returns the number taken, or -1 if the rings can't be set up.
+uint64
+sys_ring_enter(void)
+{
+  struct proc *p = myproc();
+  struct uringctx *ctx;
+  struct uring *r;
+  struct uring_sqe sqe;
+  int i, n, wait, room;
+
+  argint(0, &n);
+  argint(1, &wait);
+  if(p->uring == 0 && uringsetup(p) < 0)
+    return -1;
+  ctx = p->uring;
+  r = ctx->r;
+
+  for(i = 0; i < n; i++){
+    // see the process's submission before reading it.
+    __sync_synchronize();
+    if(ctx->sqhead == r->sqtail)
+      break;
+    acquire(&ctx->lock);
+    room = ctx->cqtail - r->cqhead + ctx->inflight < URING_ENTRIES;
+    release(&ctx->lock);
+    if(!room)
+      break;
+    sqe = r->sq[ctx->sqhead % URING_ENTRIES];
+    r->sqhead = ++ctx->sqhead;
+    uringstart(p, ctx, &sqe);
+  }
+
+  if(wait > URING_ENTRIES)
+    wait = URING_ENTRIES;
+  acquire(&ctx->lock);
+  while((int)(ctx->cqtail - r->cqhead) < wait && ctx->inflight > 0 && !killed(p))
+    sleep(ctx, &ctx->lock);
+  release(&ctx->lock);
+  return i;
+}
+
+// Is a request of p's, queued or running, using user
+// memory in [lo, hi), which p is about to give up?
+int
+uringbusy(struct proc *p, uint64 lo, uint64 hi)
+{
+  struct uringctx *ctx = p->uring;
+  int i, busy = 0;
+
+  acquire(&ctx->lock);
+  for(i = 0; i < URING_ENTRIES && !busy; i++)
+    busy = ctx->req[i].busy && uringtouches(&ctx->req[i], lo, hi);
+  release(&ctx->lock);
+  return busy;
+}
+
+// Stop p's workers, abandoning any requests in progress, and
+// free the kernel's side of the rings. The ring page goes
+// with p's page table.
+void
+uringfree(struct proc *p)
+{
+  struct uringctx *ctx = p->uring;
+  int i, pid[NUWORKER];
+
+  acquire(&ctx->lock);
+  ctx->stop = 1;
+  wakeup(ctx);
+  for(i = 0; i < NUWORKER; i++)
+    pid[i] = ctx->w[i].proc ? ctx->w[i].proc->pid : 0;
+  release(&ctx->lock);
+  // break them out of a read or recv that may never finish.
+  for(i = 0; i < NUWORKER; i++){
+    if(pid[i])
+      kill(pid[i]);
+  }
+
+  acquire(&ctx->lock);
+  for(i = 0; i < NUWORKER; i++){
+    while(ctx->w[i].proc)
+      sleep(ctx, &ctx->lock);
+  }
+  release(&ctx->lock);
+  kfree(ctx);
+  p->uring = 0;
+}
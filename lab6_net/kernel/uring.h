@@ -0,0 +1,31 @@
+// Submission and completion rings for ring_enter(),
+// in the page at URING (see kernel/uring.c).
+
+#define URING_ENTRIES 32    // entries in each ring
+
+// A system call to run: op is its number from syscall.h,
+// and args are its arguments, as they'd be in a0..a4.
+struct uring_sqe {
+  int op;
+  uint64 data;              // handed back in the completion
+  uint64 args[5];
+};
+
+struct uring_cqe {
+  uint64 data;              // from the submission
+  int res;                  // what the system call returned
+};
+
+// The process fills sq[sqtail % URING_ENTRIES] and then
+// advances sqtail; the kernel advances sqhead as it takes
+// entries. Likewise the kernel fills cq[cqtail % URING_ENTRIES]
+// and the process advances cqhead once it has read one.
+// The counts run freely and wrap around.
+struct uring {
+  uint sqhead;
+  uint sqtail;
+  uint cqhead;
+  uint cqtail;
+  struct uring_sqe sq[URING_ENTRIES];
+  struct uring_cqe cq[URING_ENTRIES];
+};
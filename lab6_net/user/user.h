@@ -26,6 +26,7 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int ring_enter(int, int);
 #ifdef LAB_NET
 int bind(uint16);
 int unbind(uint16);
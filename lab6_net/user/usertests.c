@@ -7,6 +7,7 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/uring.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -2586,6 +2587,186 @@ badarg(char *s)
   exit(0);
 }
 
+// queue a system call on the submission ring.
+static void
+ringsubmit(struct uring *r, int op, uint64 data, uint64 a0, uint64 a1, uint64 a2)
+{
+  struct uring_sqe *sqe = &r->sq[r->sqtail % URING_ENTRIES];
+
+  sqe->op = op;
+  sqe->data = data;
+  sqe->args[0] = a0;
+  sqe->args[1] = a1;
+  sqe->args[2] = a2;
+  __sync_synchronize();
+  r->sqtail++;
+}
+
+// results of completions read from the ring, by tag.
+static int ringres[256];
+static char ringdone[256];
+
+// wait for the completion tagged data, which may come after
+// others, and return its result.
+static int
+ringreap(char *s, struct uring *r, uint64 data)
+{
+  struct uring_cqe *cqe;
+  uint tail;
+
+  for(;;){
+    for(; r->cqhead != r->cqtail; r->cqhead++){
+      cqe = &r->cq[r->cqhead % URING_ENTRIES];
+      if(cqe->data >= sizeof(ringres)/sizeof(ringres[0])){
+        printf("%s: bad completion %d\n", s, (int)cqe->data);
+        exit(1);
+      }
+      ringres[cqe->data] = cqe->res;
+      ringdone[cqe->data] = 1;
+    }
+    if(ringdone[data]){
+      ringdone[data] = 0;
+      return ringres[data];
+    }
+    tail = r->cqtail;
+    ring_enter(0, 1);
+    if(r->cqtail == tail){
+      printf("%s: missing completion %d\n", s, (int)data);
+      exit(1);
+    }
+  }
+}
+
+// batched, asynchronous system calls through ring_enter().
+void
+ringtest(char *s)
+{
+  struct uring *r = (struct uring *)URING;
+  char buf[16], fbuf[16], *a;
+  int fd, n, fds[2];
+
+  if(ring_enter(0, 0) != 0){
+    printf("%s: ring_enter setup failed\n", s);
+    exit(1);
+  }
+
+  // the open's fd isn't known until it has run, so it goes
+  // alone; the write and close then share one trap. the
+  // close may finish first, but the write still has the file.
+  ringsubmit(r, SYS_open, 1, (uint64)"ringfile", O_CREATE|O_RDWR, 0);
+  if(ring_enter(1, 1) != 1 || (fd = ringreap(s, r, 1)) < 0){
+    printf("%s: open through ring failed\n", s);
+    exit(1);
+  }
+  ringsubmit(r, SYS_write, 2, fd, (uint64)"ring data", 9);
+  ringsubmit(r, SYS_close, 3, fd, 0, 0);
+  ringsubmit(r, SYS_fork, 4, 0, 0, 0);        // not allowed
+  if((n = ring_enter(URING_ENTRIES, 3)) != 3){
+    printf("%s: ring_enter took %d, expected 3\n", s, n);
+    exit(1);
+  }
+  if(ringreap(s, r, 2) != 9 || ringreap(s, r, 3) != 0 || ringreap(s, r, 4) != -1){
+    printf("%s: wrong results\n", s);
+    exit(1);
+  }
+
+  ringsubmit(r, SYS_open, 5, (uint64)"ringfile", O_RDONLY, 0);
+  if(ring_enter(1, 1) != 1 || (fd = ringreap(s, r, 5)) < 0){
+    printf("%s: reopen through ring failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, sizeof(buf));
+  ringsubmit(r, SYS_read, 6, fd, (uint64)buf, sizeof(buf));
+  ringsubmit(r, SYS_close, 7, fd, 0, 0);
+  if(ring_enter(2, 2) != 2 || ringreap(s, r, 6) != 9 || ringreap(s, r, 7) != 0){
+    printf("%s: read through ring failed\n", s);
+    exit(1);
+  }
+  if(strcmp(buf, "ring data") != 0){
+    printf("%s: read back %s\n", s, buf);
+    exit(1);
+  }
+
+  // ring_enter() returns while a read waits for data.
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, sizeof(buf));
+  ringsubmit(r, SYS_read, 8, fds[0], (uint64)buf, sizeof(buf));
+  if(ring_enter(1, 0) != 1){
+    printf("%s: pipe read not taken\n", s);
+    exit(1);
+  }
+  if(r->cqhead != r->cqtail){
+    printf("%s: pipe read finished without data\n", s);
+    exit(1);
+  }
+
+  // ... and doesn't hold up a read from disk.
+  if((fd = open("ringfile", O_RDONLY)) < 0){
+    printf("%s: open ringfile failed\n", s);
+    exit(1);
+  }
+  memset(fbuf, 0, sizeof(fbuf));
+  ringsubmit(r, SYS_read, 9, fd, (uint64)fbuf, sizeof(fbuf));
+  if(ring_enter(1, 1) != 1 || ringreap(s, r, 9) != 9 || strcmp(fbuf, "ring data") != 0){
+    printf("%s: disk read behind a pipe read failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  // sbrk() won't give back memory a request is using.
+  a = sbrk(PGSIZE);
+  ringsubmit(r, SYS_read, 10, fds[0], (uint64)(a + PGSIZE - 1), 1);
+  if(ring_enter(1, 0) != 1){
+    printf("%s: second pipe read not taken\n", s);
+    exit(1);
+  }
+  if(sbrk(-PGSIZE) != (char*)-1){
+    printf("%s: sbrk() freed memory a request is using\n", s);
+    exit(1);
+  }
+
+  if(write(fds[1], "x", 1) != 1){
+    printf("%s: pipe write failed\n", s);
+    exit(1);
+  }
+  if(ringreap(s, r, 8) != 1 || buf[0] != 'x'){
+    printf("%s: pipe read through ring failed\n", s);
+    exit(1);
+  }
+  if(write(fds[1], "y", 1) != 1 || ringreap(s, r, 10) != 1 || a[PGSIZE-1] != 'y'){
+    printf("%s: pipe read into sbrk() memory failed\n", s);
+    exit(1);
+  }
+  if(sbrk(-PGSIZE) == (char*)-1){
+    printf("%s: sbrk() refused once the request was done\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  // a full completion ring stops ring_enter().
+  for(n = 0; n < URING_ENTRIES; n++)
+    ringsubmit(r, SYS_close, 100 + n, -1, 0, 0);
+  if((n = ring_enter(URING_ENTRIES, 0)) != URING_ENTRIES){
+    printf("%s: took %d of %d\n", s, n, URING_ENTRIES);
+    exit(1);
+  }
+  ringsubmit(r, SYS_close, 200, -1, 0, 0);
+  if(ring_enter(1, 0) != 0){
+    printf("%s: took one with a full completion ring\n", s);
+    exit(1);
+  }
+  r->cqhead = r->cqtail;
+  if(ring_enter(1, 1) != 1 || ringreap(s, r, 200) != -1){
+    printf("%s: last submission not run\n", s);
+    exit(1);
+  }
+  unlink("ringfile");
+}
+
 struct test {
   void (*f)(char *);
   char *s;
@@ -2650,6 +2831,7 @@ struct test {
   {sbrklast, "sbrklast"},
   {sbrk8000, "sbrk8000"},
   {badarg, "badarg" },
+  {ringtest, "ringtest" },
 
   { 0, 0},
 };
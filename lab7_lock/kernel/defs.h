@@ -89,11 +89,18 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             clone(uint64, uint64, uint64);
+int             threaded(struct proc*);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+int             setpriority(int, int);
+int             getpriority(int);
+int             setaffinity(int, int);
+int             getaffinity(int);
+int             getrusage(int, uint64);
+int             setscheduler(int, int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
 struct cpu*     mycpu(void);
@@ -105,12 +112,24 @@ void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
+int             waitpid(int, uint64, int);
 void            wakeup(void*);
+void            wakeup_one(void*);
+int             wakeup_n(void*, int);
 void            yield(void);
+void            makerunnable(struct proc*);
+void            tlbshootdown(pagetable_t);
+void            rebalance(void);
+void            boost(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 
+// futex.c
+void            futexinit(void);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
+
 // swtch.S
 void            swtch(struct context*, struct context*);
 
@@ -149,6 +168,14 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// timer.c
+void            wheelinit(void);
+void            wheelintr(void);
+int             wheelsleep(uint64);
+uint64          nsecs(void);
+uint64          time2ns(uint64);
+uint64          ns2time(uint64);
+
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
@@ -172,6 +199,7 @@ pagetable_t     uvmcreate(void);
 void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
+uint64          uvmshrink(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
@@ -3,3 +3,10 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+
+// waitpid() options
+#define WNOHANG   0x001
+
+// setscheduler() policies
+#define SCHED_OTHER 0     // time-shared by the build's scheduler
+#define SCHED_FIFO  1     // real-time: runs until it blocks
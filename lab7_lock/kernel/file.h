@@ -39,3 +39,4 @@ extern struct devsw devsw[];
 
 #define CONSOLE 1
 #define STATS   2
+#define SCHEDSTATS 3
@@ -654,8 +654,12 @@ namex(char *path, int nameiparent, char *name)
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    struct files *fs = myproc()->files;
+    acquire(&fs->lock);
+    ip = idup(fs->cwd);
+    release(&fs->lock);
+  }
 
   while((path = skipelem(path, name)) != 0){
     ilock(ip);
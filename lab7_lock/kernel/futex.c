@@ -0,0 +1,99 @@
+// Futexes: sleeping on user memory.
+//
+// A thread that finds a lock word in user memory busy calls
+// futexwait() to sleep until it might have changed, and the
+// thread that changes it calls futexwake(). User code takes
+// the uncontended path with atomic instructions alone; see
+// user/usync.c.
+//
+// A futex is named by the physical address of its word, so
+// that threads of one address space and processes sharing
+// the page agree on it. Waiters sleep() on that address in
+// the wait queues of proc.c. A spinlock per hash bucket
+// makes checking the word and going to sleep atomic with
+// respect to futexwake().
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NFUTEX 64
+
+struct spinlock futexlocks[NFUTEX];
+
+void
+futexinit(void)
+{
+  int i;
+
+  for(i = 0; i < NFUTEX; i++)
+    initlock(&futexlocks[i], "futex");
+}
+
+// The physical address of the int at user address addr,
+// or 0 if it isn't mapped or aligned.
+static uint64
+futexaddr(uint64 addr)
+{
+  uint64 pa;
+
+  if(addr % sizeof(int))
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, addr)) == 0)
+    return 0;
+  return pa + (addr % PGSIZE);
+}
+
+static struct spinlock*
+futexlock(uint64 pa)
+{
+  return &futexlocks[(pa / sizeof(int)) % NFUTEX];
+}
+
+// Sleep until woken by futexwake(addr), if the int at addr
+// still holds val. Returns -1 if it doesn't, if addr is
+// bad, or if killed. Callers must recheck the word, since
+// another thread may have changed it again since the wakeup.
+int
+futexwait(uint64 addr, int val)
+{
+  struct proc *p = myproc();
+  struct spinlock *lk;
+  uint64 pa;
+
+  if((pa = futexaddr(addr)) == 0)
+    return -1;
+  lk = futexlock(pa);
+  acquire(lk);
+  if(*(int*)pa != val || killed(p)){
+    release(lk);
+    return -1;
+  }
+  sleep((void*)pa, lk);
+  release(lk);
+  return killed(p) ? -1 : 0;
+}
+
+// Wake up to n threads sleeping in futexwait(addr).
+// Returns how many were woken, or -1 if addr is bad.
+int
+futexwake(uint64 addr, int n)
+{
+  struct spinlock *lk;
+  uint64 pa;
+  int woken;
+
+  if((pa = futexaddr(addr)) == 0)
+    return -1;
+  if(n <= 0)
+    return 0;
+  lk = futexlock(pa);
+  acquire(lk);
+  woken = wakeup_n((void*)pa, n);
+  release(lk);
+  return woken;
+}
@@ -25,6 +25,11 @@
 #define VIRTIO0 0x10001000
 #define VIRTIO0_IRQ 1
 
+// core local interruptor (CLINT), whose MSIP registers
+// send machine-mode software interrupts (IPIs) to harts.
+#define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
+
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
 #define PLIC_PRIORITY (PLIC + 0x0)
@@ -57,3 +62,8 @@
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// threads made by clone() share a user page table, so
+// each has its trapframe in its own slot below TRAMPOLINE;
+// slot 0 is TRAPFRAME.
+#define THREADFRAME(slot) (TRAMPOLINE - ((slot)+1)*PGSIZE)
@@ -1,5 +1,7 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      1000  // maximum number of processes
+#define NTHREAD      16  // maximum threads sharing a page table
 #define NCPU          8  // maximum number of CPUs
+#define ALLCPUS ((1 << NCPU) - 1) // affinity mask of every CPU
 #define NOFILE       16  // open files per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
@@ -12,4 +14,18 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define BALANCE      10    // ticks between run queue rebalances
+#define NPRIO        4     // scheduling priority levels
+#define QUANTUM      1     // MLFQ ticks at level 0, doubling per level
+#define BOOST        50    // MLFQ ticks between priority boosts
+#define SCHEDGRAN    1000000 // CFS vruntime lag that forces preemption
+#define RTLIMIT      10    // ticks SCHED_FIFO may run before others get a turn
+// r_time() units per second: the timebase-frequency of /cpus in
+// the device tree, which qemu's virt machine sets to 10MHz.
+// Convert with time2ns() and ns2time() rather than by hand.
+#define TIMEFREQ     10000000
+#ifndef HZ
+#define HZ           10    // clock ticks per second
+#endif
+#define TICK         (TIMEFREQ / HZ) // r_time() units per clock tick
 
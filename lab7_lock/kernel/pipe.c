@@ -85,11 +85,13 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
   acquire(&pi->lock);
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
+      // pass on any wakeup meant for a writer.
+      wakeup_one(&pi->nwrite);
       release(&pi->lock);
       return -1;
     }
     if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
-      wakeup(&pi->nread);
+      wakeup_one(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     } else {
       char ch;
@@ -99,7 +101,10 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       i++;
     }
   }
-  wakeup(&pi->nread);
+  wakeup_one(&pi->nread);
+  // room left for another writer?
+  if(pi->nwrite != pi->nread + PIPESIZE)
+    wakeup_one(&pi->nwrite);
   release(&pi->lock);
 
   return i;
@@ -115,6 +120,8 @@ piperead(struct pipe *pi, uint64 addr, int n)
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
     if(killed(pr)){
+      // pass on any wakeup meant for a reader.
+      wakeup_one(&pi->nread);
       release(&pi->lock);
       return -1;
     }
@@ -127,7 +134,10 @@ piperead(struct pipe *pi, uint64 addr, int n)
     if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
       break;
   }
-  wakeup(&pi->nwrite);  //DOC: piperead-wakeup
+  wakeup_one(&pi->nwrite);  //DOC: piperead-wakeup
+  // data left for another reader?
+  if(pi->nread != pi->nwrite)
+    wakeup_one(&pi->nread);
   release(&pi->lock);
   return i;
 }
@@ -5,57 +5,75 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "fcntl.h"
+#include "rusage.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// struct procs come from a slab: pages carved into procs,
+// which go on a free list when unused and are never given
+// back. Each keeps its lock and kernel stack across reuse.
+// Processes in use are found by pid in a hash table.
+#define NPIDHASH 64
+struct proc *pidhash[NPIDHASH];
+struct proc *freeprocs;
+struct proc *allprocs;        // every proc made, for procdump()
+int nprocs;                   // procs made, and KSTACK slots used
 
 struct proc *initproc;
 
 int nextpid = 1;
-struct spinlock pid_lock;
+struct spinlock pid_lock;     // nextpid, pidhash, freeprocs, nprocs
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void finishswitch(void);
+static int spawn(struct proc *p, struct proc *np);
 
 extern char trampoline[]; // trampoline.S
 
+// Processes asleep in sleep(), hashed by chan. Each bucket
+// is a FIFO list linked through p->wqnext, so that wakeup()
+// looks only at processes that might be sleeping on chan.
+#define NWAITQ 64
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+} waitq[NWAITQ];
+
+// Descriptor tables come from a slab too. Threads made by
+// clone() share one; fork() copies it.
+struct files *freefiles;
+struct spinlock files_lock;   // freefiles
+
+// Threads made by clone() share a user page table. They are
+// linked in a ring through p->tnext, and each has its
+// trapframe mapped in a slot of its own (see THREADFRAME).
+// Each keeps the shared size in p->sz.
+// must be acquired after any p->lock.
+struct spinlock thread_lock;  // tnext, tslot, and sz of threads
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl)
-{
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-  }
-}
-
 // initialize the proc table.
 void
 procinit(void)
 {
-  struct proc *p;
+  struct cpu *c;
+  int i;
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->state = UNUSED;
-      p->kstack = KSTACK((int) (p - proc));
-  }
+  initlock(&thread_lock, "thread_lock");
+  initlock(&files_lock, "files_lock");
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    initlock(&c->rq.lock, "runq");
+  for(i = 0; i < NWAITQ; i++)
+    initlock(&waitq[i].lock, "waitq");
 }
 
 // Must be called with interrupts disabled,
@@ -89,54 +107,278 @@ myproc(void)
   return p;
 }
 
-int
-allocpid()
+// Carve a new page into procs, each with a kernel stack
+// mapped high in memory, followed by an invalid guard page,
+// and put them on the free list.
+// Caller must hold pid_lock.
+static void
+procslab(void)
 {
-  int pid;
-  
-  acquire(&pid_lock);
-  pid = nextpid;
-  nextpid = nextpid + 1;
-  release(&pid_lock);
+  extern pagetable_t kernel_pagetable;
+  struct proc *p, *slab;
+  char *pa;
+
+  if((slab = (struct proc*)kalloc()) == 0)
+    return;
+  memset(slab, 0, PGSIZE);
+  for(p = slab; p + 1 <= (struct proc*)((char*)slab + PGSIZE); p++){
+    if(nprocs >= NPROC || (pa = kalloc()) == 0)
+      break;
+    p->kstack = KSTACK(nprocs);
+    if(mappages(kernel_pagetable, p->kstack, PGSIZE, (uint64)pa, PTE_R | PTE_W) != 0){
+      kfree(pa);
+      break;
+    }
+    nprocs++;
+    initlock(&p->lock, "proc");
+    p->state = UNUSED;
+    p->next = freeprocs;
+    freeprocs = p;
+    // procdump() and others walk allprocs without a lock.
+    p->allnext = allprocs;
+    __sync_synchronize();
+    allprocs = p;
+  }
+  // a new mapping needs no TLB flush on other harts;
+  // nothing can be cached for an address never mapped.
+  sfence_vma();
+  if(p == slab)
+    kfree((char*)slab);
+}
 
-  return pid;
+static struct proc**
+pidbucket(int pid)
+{
+  return &pidhash[(uint)pid % NPIDHASH];
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
-// and return with p->lock held.
-// If there are no free procs, or a memory allocation fails, return 0.
+// Return the process with the given pid, with p->lock
+// held, or 0 if there is none.
 static struct proc*
-allocproc(void)
+findproc(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  acquire(&pid_lock);
+  for(p = *pidbucket(pid); p; p = p->next){
+    if(p->hashpid == pid)
+      break;
+  }
+  if(p)
     acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
+  release(&pid_lock);
+  // it may have been freed since.
+  if(p && (p->pid != pid || p->state == UNUSED)){
+    release(&p->lock);
+    p = 0;
+  }
+  return p;
+}
+
+// Return p, cleaned up by freeproc(), to the free list.
+// Caller must not hold p->lock.
+static void
+putproc(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for(pp = pidbucket(p->hashpid); *pp; pp = &(*pp)->next){
+    if(*pp == p){
+      *pp = p->next;
+      break;
     }
   }
+  p->next = freeprocs;
+  freeprocs = p;
+  release(&pid_lock);
+}
+
+// Map np's trapframe in a free slot of p's page table,
+// and make np one of p's threads.
+// Returns -1 if p has NTHREAD threads already.
+static int
+threadshare(struct proc *np, struct proc *p)
+{
+  struct proc *t;
+  uint used = 0;
+  int slot;
+
+  acquire(&thread_lock);
+  t = p;
+  do {
+    used |= 1 << t->tslot;
+    t = t->tnext;
+  } while(t != p);
+  for(slot = 0; slot < NTHREAD; slot++){
+    if((used & (1 << slot)) == 0)
+      break;
+  }
+  if(slot == NTHREAD ||
+     mappages(p->pagetable, THREADFRAME(slot), PGSIZE,
+              (uint64)np->trapframe, PTE_R | PTE_W) < 0){
+    release(&thread_lock);
+    return -1;
+  }
+  np->pagetable = p->pagetable;
+  np->sz = p->sz;
+  np->tslot = slot;
+  np->tnext = p->tnext;
+  p->tnext = np;
+  release(&thread_lock);
   return 0;
+}
 
-found:
-  p->pid = allocpid();
+// Take p out of its ring of threads.
+// Returns 1 if p was the last to use its page table.
+static int
+threadleave(struct proc *p)
+{
+  struct proc *t;
+  int last;
+
+  acquire(&thread_lock);
+  last = p->tnext == p;
+  for(t = p; t->tnext != p; t = t->tnext)
+    ;
+  t->tnext = p->tnext;
+  p->tnext = p;
+  release(&thread_lock);
+  return last;
+}
+
+// Does p share its page table with other threads?
+int
+threaded(struct proc *p)
+{
+  int r;
+
+  acquire(&thread_lock);
+  r = p->tnext != p;
+  release(&thread_lock);
+  return r;
+}
+
+// Return an empty descriptor table with one user, carving
+// a new page into tables if need be, or 0 if out of memory.
+static struct files*
+filesalloc(void)
+{
+  struct files *fs, *slab;
+
+  acquire(&files_lock);
+  if(freefiles == 0 && (slab = (struct files*)kalloc()) != 0){
+    memset(slab, 0, PGSIZE);
+    for(fs = slab; fs + 1 <= (struct files*)((char*)slab + PGSIZE); fs++){
+      initlock(&fs->lock, "files");
+      fs->next = freefiles;
+      freefiles = fs;
+    }
+  }
+  if((fs = freefiles) != 0){
+    freefiles = fs->next;
+    fs->ref = 1;
+  }
+  release(&files_lock);
+  return fs;
+}
+
+// Return a new table holding references to the files
+// and directory in fs, or 0 if out of memory.
+static struct files*
+filescopy(struct files *fs)
+{
+  struct files *nfs;
+  int i;
+
+  if((nfs = filesalloc()) == 0)
+    return 0;
+  acquire(&fs->lock);
+  for(i = 0; i < NOFILE; i++)
+    if(fs->ofile[i])
+      nfs->ofile[i] = filedup(fs->ofile[i]);
+  nfs->cwd = idup(fs->cwd);
+  release(&fs->lock);
+  return nfs;
+}
+
+// Drop a user of fs. The last one closes its files
+// and directory, and frees it.
+static void
+filesput(struct files *fs)
+{
+  struct file *f;
+  int fd, last;
+
+  acquire(&fs->lock);
+  last = --fs->ref == 0;
+  release(&fs->lock);
+  if(!last)
+    return;
+
+  for(fd = 0; fd < NOFILE; fd++){
+    if((f = fs->ofile[fd]) != 0){
+      fs->ofile[fd] = 0;
+      fileclose(f);
+    }
+  }
+  begin_op();
+  iput(fs->cwd);
+  end_op();
+  fs->cwd = 0;
+
+  acquire(&files_lock);
+  fs->next = freefiles;
+  freefiles = fs;
+  release(&files_lock);
+}
+
+// Take an UNUSED proc from the free list, making more if
+// need be, give it a pid and enter it in the pid hash.
+// Then initialize state required to run in the kernel,
+// and return with p->lock held. If share is not 0, the
+// new proc is a thread using share's page table.
+// If there are no free procs, or a memory allocation fails, return 0.
+static struct proc*
+allocproc(struct proc *share)
+{
+  struct proc *p;
+
+  acquire(&pid_lock);
+  if(freeprocs == 0)
+    procslab();
+  if((p = freeprocs) == 0){
+    release(&pid_lock);
+    return 0;
+  }
+  freeprocs = p->next;
+  acquire(&p->lock);
+  p->pid = nextpid++;
+  p->hashpid = p->pid;
   p->state = USED;
+  p->next = *pidbucket(p->pid);
+  *pidbucket(p->pid) = p;
+  release(&pid_lock);
+  p->tnext = p;
+  p->tslot = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
     freeproc(p);
     release(&p->lock);
+    putproc(p);
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
+  // An empty user page table, or share's.
+  if(share)
+    threadshare(p, share);
+  else
+    p->pagetable = proc_pagetable(p);
   if(p->pagetable == 0){
     freeproc(p);
     release(&p->lock);
+    putproc(p);
     return 0;
   }
 
@@ -158,8 +400,12 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
-  if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+  if(p->pagetable){
+    if(threadleave(p))
+      proc_freepagetable(p->pagetable, p->sz);
+    else
+      uvmunmap(p->pagetable, THREADFRAME(p->tslot), 1, 0);
+  }
   p->pagetable = 0;
   p->sz = 0;
   p->pid = 0;
@@ -168,6 +414,13 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
+  p->prio = 0;
+  p->level = 0;
+  p->qticks = 0;
+  p->vruntime = 0;
+  p->policy = SCHED_OTHER;
+  memset(&p->usage, 0, sizeof(p->usage));
+  memset(&p->cusage, 0, sizeof(p->cusage));
   p->state = UNUSED;
 }
 
@@ -210,8 +463,16 @@ proc_pagetable(struct proc *p)
 void
 proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
+  pte_t *pte;
+  int slot;
+
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  // the last thread to leave need not have had slot 0.
+  for(slot = 0; slot < NTHREAD; slot++){
+    pte = walk(pagetable, THREADFRAME(slot), 0);
+    if(pte && (*pte & PTE_V))
+      uvmunmap(pagetable, THREADFRAME(slot), 1, 0);
+  }
   uvmfree(pagetable, sz);
 }
 
@@ -234,7 +495,7 @@ userinit(void)
 {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0);
   initproc = p;
   
   // allocate one user page and copy initcode's instructions
@@ -247,9 +508,13 @@ userinit(void)
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  if((p->files = filesalloc()) == 0)
+    panic("userinit: files");
+  p->files->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  p->cpu = 0;
+  p->affinity = ALLCPUS;
+  makerunnable(p);
 
   release(&p->lock);
 }
@@ -261,16 +526,25 @@ growproc(int n)
 {
   uint64 sz;
   struct proc *p = myproc();
+  struct proc *t;
 
+  // other threads may be growing the same page table.
+  acquire(&thread_lock);
   sz = p->sz;
   if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&thread_lock);
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    sz = uvmshrink(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  t = p;
+  do {
+    t->sz = sz;
+    t = t->tnext;
+  } while(t != p);
+  release(&thread_lock);
   return 0;
 }
 
@@ -279,22 +553,34 @@ growproc(int n)
 int
 fork(void)
 {
-  int i, pid;
   struct proc *np;
   struct proc *p = myproc();
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0)) == 0){
     return -1;
   }
 
   // Copy user memory from parent to child.
+  // threads of the parent may be resizing it.
+  acquire(&thread_lock);
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+    release(&thread_lock);
     freeproc(np);
     release(&np->lock);
+    putproc(np);
     return -1;
   }
   np->sz = p->sz;
+  release(&thread_lock);
+
+  // copy the descriptor table.
+  if((np->files = filescopy(p->files)) == 0){
+    freeproc(np);
+    release(&np->lock);
+    putproc(np);
+    return -1;
+  }
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -302,24 +588,70 @@ fork(void)
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // increment reference counts on open file descriptors.
-  for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+  return spawn(p, np);
+}
+
+// Create a thread sharing the caller's address space, open
+// files and current directory, which starts by calling
+// fn(arg) on the user stack whose top is stack. It is
+// otherwise a child like fork()'s, waited for with wait();
+// fn must call exit() rather than return.
+int
+clone(uint64 fn, uint64 stack, uint64 arg)
+{
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc(p)) == 0){
+    return -1;
+  }
+
+  // share the descriptor table.
+  acquire(&p->files->lock);
+  p->files->ref++;
+  release(&p->files->lock);
+  np->files = p->files;
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->sp = stack;
+  np->trapframe->a0 = arg;
+
+  return spawn(p, np);
+}
+
+// Finish making np, a new child of p from allocproc(),
+// and let it run. Caller holds np->lock.
+// Returns np's pid.
+static int
+spawn(struct proc *p, struct proc *np)
+{
+  int pid;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->cpu = p->cpu;
+  np->affinity = p->affinity;
+  np->prio = p->prio;
+  np->policy = p->policy;
+#ifdef SCHED_MLFQ
+  np->level = p->prio;
+#endif
+#ifdef SCHED_CFS
+  np->vruntime = p->vruntime;
+#endif
   pid = np->pid;
 
   release(&np->lock);
 
   acquire(&wait_lock);
   np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  makerunnable(np);
   release(&np->lock);
 
   return pid;
@@ -332,12 +664,17 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  for(pp = p->children; ; pp = pp->sibling){
+    pp->parent = initproc;
+    if(pp->sibling == 0)
+      break;
   }
+  pp->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -351,19 +688,9 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
-    }
-  }
-
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+  // Close all open files, unless other threads share them.
+  filesput(p->files);
+  p->files = 0;
 
   acquire(&wait_lock);
 
@@ -385,42 +712,97 @@ exit(int status)
   panic("zombie exit");
 }
 
+static void
+addusage(struct cputime *to, struct cputime *from)
+{
+  to->utime += from->utime;
+  to->stime += from->stime;
+  to->nvcsw += from->nvcsw;
+  to->nivcsw += from->nivcsw;
+  to->nfault += from->nfault;
+}
+
+// Copy the caller's resource usage, or with RUSAGE_CHILDREN
+// that of the children it has waited for, to the struct
+// rusage at user address addr. Returns 0, or -1 on error.
+int
+getrusage(int who, uint64 addr)
+{
+  struct proc *p = myproc();
+  struct cputime t;
+  struct rusage ru;
+
+  if(who == RUSAGE_SELF){
+    push_off();
+    t = p->usage;
+    t.stime += r_time() - p->tstamp;
+    pop_off();
+  } else if(who == RUSAGE_CHILDREN){
+    acquire(&wait_lock);
+    t = p->cusage;
+    release(&wait_lock);
+  } else {
+    return -1;
+  }
+  ru.utime = time2ns(t.utime);
+  ru.stime = time2ns(t.stime);
+  ru.nvcsw = t.nvcsw;
+  ru.nivcsw = t.nivcsw;
+  ru.nfault = t.nfault;
+  return copyout(p->pagetable, addr, (char*)&ru, sizeof(ru));
+}
+
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
 int
 wait(uint64 addr)
 {
-  struct proc *pp;
-  int havekids, pid;
+  return waitpid(-1, addr, 0);
+}
+
+// Wait for child pid, or any child if pid is -1, to exit,
+// and return its pid. With WNOHANG, return 0 instead of
+// waiting. Return -1 if there is no such child.
+int
+waitpid(int pid, uint64 addr, int options)
+{
+  struct proc *pp, **ppp;
+  int havekids;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
     havekids = 0;
-    for(pp = proc; pp < &proc[NPROC]; pp++){
-      if(pp->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&pp->lock);
-
-        havekids = 1;
-        if(pp->state == ZOMBIE){
-          // Found one.
-          pid = pp->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
-                                  sizeof(pp->xstate)) < 0) {
-            release(&pp->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(pp);
+    for(ppp = &p->children; (pp = *ppp) != 0; ppp = &pp->sibling){
+      // only the parent changes pp->pid once pp exists.
+      if(pid != -1 && pp->pid != pid)
+        continue;
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&pp->lock);
+
+      havekids = 1;
+      if(pp->state == ZOMBIE){
+        // Found one.
+        pid = pp->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+                                sizeof(pp->xstate)) < 0) {
           release(&pp->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        *ppp = pp->sibling;
+        pp->sibling = 0;
+        addusage(&p->cusage, &pp->usage);
+        addusage(&p->cusage, &pp->cusage);
+        freeproc(pp);
         release(&pp->lock);
+        putproc(pp);
+        release(&wait_lock);
+        return pid;
       }
+      release(&pp->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -428,16 +810,602 @@ wait(uint64 addr)
       release(&wait_lock);
       return -1;
     }
+    if(options & WNOHANG){
+      release(&wait_lock);
+      return 0;
+    }
     
     // Wait for a child to exit.
     sleep(p, &wait_lock);  //DOC: wait-sleep
   }
 }
 
+#ifdef SCHED_CFS
+// Add p to rq's heap, which is ordered by vruntime; l is
+// unused. Caller must hold rq->lock.
+static void
+levelpush(struct runq *rq, struct proc *p, int l)
+{
+  int i = rq->nheap++;
+
+  while(i > 0 && rq->heap[(i-1)/2]->vruntime > p->vruntime){
+    rq->heap[i] = rq->heap[(i-1)/2];
+    i = (i-1)/2;
+  }
+  rq->heap[i] = p;
+}
+
+// Remove and return the process in rq's heap with the least
+// vruntime, or 0 if it is empty. Caller must hold rq->lock.
+static struct proc*
+levelpop(struct runq *rq, int *lp)
+{
+  struct proc *p, *last;
+  int i, c;
+
+  if(rq->nheap == 0)
+    return 0;
+  p = rq->heap[0];
+  last = rq->heap[--rq->nheap];
+  for(i = 0; (c = 2*i + 1) < rq->nheap; i = c){
+    if(c + 1 < rq->nheap && rq->heap[c+1]->vruntime < rq->heap[c]->vruntime)
+      c++;
+    if(last->vruntime <= rq->heap[c]->vruntime)
+      break;
+    rq->heap[i] = rq->heap[c];
+  }
+  rq->heap[i] = last;
+  *lp = 0;
+  return p;
+}
+#else
+// Append p to level l of rq. Caller must hold rq->lock.
+static void
+levelpush(struct runq *rq, struct proc *p, int l)
+{
+  p->rqnext = 0;
+  if(rq->tail[l])
+    rq->tail[l]->rqnext = p;
+  else
+    rq->head[l] = p;
+  rq->tail[l] = p;
+}
+
+// Unlink and return the first process of the highest-priority
+// non-empty level of rq, or 0 if all are empty, setting *lp
+// to its level. Caller must hold rq->lock.
+static struct proc*
+levelpop(struct runq *rq, int *lp)
+{
+  struct proc *p;
+  int l;
+
+  for(l = 0; l < NPRIO; l++){
+    if((p = rq->head[l]) != 0){
+      rq->head[l] = p->rqnext;
+      if(rq->head[l] == 0)
+        rq->tail[l] = 0;
+      p->rqnext = 0;
+      *lp = l;
+      return p;
+    }
+  }
+  return 0;
+}
+#endif
+
+// Should p wait and run as a real-time process? A racy
+// look unless the caller holds p->lock.
+static int
+isrt(struct proc *p)
+{
+  return p->policy == SCHED_FIFO && !p->throttled;
+}
+
+// Add p to rq: at the tail of the SCHED_FIFO list, or
+// else at level l. Caller must hold rq->lock.
+static void
+runqpush(struct runq *rq, struct proc *p, int l)
+{
+  if(isrt(p)){
+    p->rqnext = 0;
+    if(rq->rttail)
+      rq->rttail->rqnext = p;
+    else
+      rq->rthead = p;
+    rq->rttail = p;
+  } else {
+    levelpush(rq, p, l);
+  }
+  rq->n++;
+}
+
+// Remove and return the next process to run from rq, the
+// first SCHED_FIFO one if any, or 0 if rq is empty, setting
+// *lp to its level. Caller must hold rq->lock.
+static struct proc*
+runqpop(struct runq *rq, int *lp)
+{
+  struct proc *p;
+
+  if((p = rq->rthead) != 0){
+    rq->rthead = p->rqnext;
+    if(rq->rthead == 0)
+      rq->rttail = 0;
+    p->rqnext = 0;
+    *lp = p->level;
+  } else if((p = levelpop(rq, lp)) == 0){
+    return 0;
+  }
+  rq->n--;
+  return p;
+}
+
+// Send an IPI to c, ending its wfi in idle().
+static void
+ipi(struct cpu *c)
+{
+  *(uint32*)CLINT_MSIP(c - cpus) = 1;
+}
+
+// Make sure no other hart's TLB still holds entries from
+// pagetable, whose PTEs the caller has changed. Only harts
+// in user space with pagetable can; uservec in trampoline.S
+// flushes the TLB on every trap, so an IPI is enough, and
+// usertrap() acknowledges by clearing c->tlbflush.
+void
+tlbshootdown(pagetable_t pagetable)
+{
+  struct cpu *c;
+  uint64 sent = 0;
+  int me;
+
+  // order the caller's PTE stores before reading upagetable;
+  // a hart that sets it later will see the new PTEs.
+  __sync_synchronize();
+  push_off();
+  me = cpuid();
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c - cpus != me && c->upagetable == pagetable){
+      c->tlbflush = 1;
+      __sync_synchronize();
+      ipi(c);
+      sent |= 1L << (c - cpus);
+    }
+  }
+  pop_off();
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if((sent >> (c - cpus)) & 1){
+      while(__atomic_load_n(&c->tlbflush, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&c->upagetable, __ATOMIC_ACQUIRE) == pagetable)
+        ;
+    }
+  }
+}
+
+// May p run on c?
+static int
+allowed(struct proc *p, struct cpu *c)
+{
+  return (p->affinity >> (c - cpus)) & 1;
+}
+
+// The CPU p should wait for: the last one it ran on, for
+// its warm caches, if p's affinity allows, or else the
+// allowed one with the shortest run queue.
+// Caller must hold p->lock, or have p off every run queue.
+static struct cpu*
+cpufor(struct proc *p)
+{
+  struct cpu *c = &cpus[p->cpu], *oc;
+
+  if(allowed(p, c))
+    return c;
+  for(oc = cpus; oc < &cpus[NCPU]; oc++){
+    if(oc->online && allowed(p, oc) && (!allowed(p, c) || oc->rq.n < c->rq.n))
+      c = oc;
+  }
+  return c;
+}
+
+#ifdef SCHED_MLFQ
+// Priority boosts so far. boost() only requeues the
+// waiting processes; the others catch up on a boost when
+// they next tick or are queued.
+static uint boostepoch;
+
+// Give p any boost it has missed: move it back up to the
+// level given by its priority.
+// Caller must hold p->lock, or the lock of the run queue
+// p is on.
+static void
+catchup(struct proc *p)
+{
+  uint e = __atomic_load_n(&boostepoch, __ATOMIC_RELAXED);
+
+  if(p->boosted != e){
+    p->boosted = e;
+    p->level = p->prio;
+    p->qticks = 0;
+  }
+}
+#endif
+
+// Mark p RUNNABLE and append it to the run queue of
+// cpufor(p), at level p->level. A process is on a run
+// queue exactly when it is RUNNABLE.
+// Caller must hold p->lock.
+void
+makerunnable(struct proc *p)
+{
+  struct cpu *c = cpufor(p), *oc;
+  struct runq *rq = &c->rq;
+  struct proc *cp;
+
+  p->state = RUNNABLE;
+  p->readyat = r_time();
+#ifdef SCHED_MLFQ
+  catchup(p);
+#endif
+  acquire(&rq->lock);
+#ifdef SCHED_CFS
+  // a process that has been asleep doesn't get to catch
+  // up on all the CPU time it didn't use.
+  if(p->vruntime < rq->minvruntime)
+    p->vruntime = rq->minvruntime;
+#endif
+  runqpush(rq, p, p->level);
+  release(&rq->lock);
+
+  // wake c if it is idle. a real-time p preempts c's
+  // process unless that is real-time too. otherwise p
+  // must wait for c, so wake an idle CPU to steal it.
+  if(c->idle){
+    ipi(c);
+  } else if(isrt(p) && (cp = c->proc) != 0 && !isrt(cp)){
+    c->resched = 1;
+    ipi(c);
+  } else {
+    for(oc = cpus; oc < &cpus[NCPU]; oc++){
+      if(oc->idle && allowed(p, oc)){
+        ipi(oc);
+        break;
+      }
+    }
+  }
+}
+
+#ifdef SCHED_CFS
+// Charge p, which is running, for the CPU time it has used
+// since p->runstart, scaled by its weight: 1024 at priority
+// 0, halving with each step of priority, so that CPU time
+// is shared in proportion to weight.
+// Caller must hold p->lock.
+static void
+account(struct proc *p)
+{
+  uint64 now = r_time();
+
+  p->vruntime += (now - p->runstart) * 1024 / (1024 >> p->prio);
+  p->runstart = now;
+}
+
+// Has a process waiting in rq fallen more than SCHEDGRAN
+// of vruntime behind v?
+static int
+runqbehind(struct runq *rq, uint64 v)
+{
+  int r;
+
+  acquire(&rq->lock);
+  r = rq->nheap > 0 && rq->heap[0]->vruntime + SCHEDGRAN < v;
+  release(&rq->lock);
+  return r;
+}
+#endif
+
+#ifdef SCHED_MLFQ
+// Is a process waiting in rq at a better level than l?
+// A racy look, for deciding whether to preempt.
+static int
+runqbetter(struct runq *rq, int l)
+{
+  int i;
+
+  for(i = 0; i < l; i++){
+    if(rq->head[i])
+      return 1;
+  }
+  return 0;
+}
+
+// Move every process back up to the level given by its
+// priority, so that CPU-bound processes demoted to the
+// bottom level are not starved. Called by clockintr()
+// every BOOST ticks. Only the waiting processes are moved
+// here, without taking their p->locks; catchup() moves
+// the running and sleeping ones later.
+void
+boost(void)
+{
+  struct proc *p;
+  struct cpu *c;
+  struct runq rq;
+  int l;
+
+  __atomic_fetch_add(&boostepoch, 1, __ATOMIC_RELAXED);
+
+  // requeue the waiting processes at their new levels.
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    memset(&rq, 0, sizeof(rq));
+    acquire(&c->rq.lock);
+    while((p = runqpop(&c->rq, &l)) != 0){
+      catchup(p);
+      runqpush(&rq, p, p->level);
+    }
+    for(l = 0; l < NPRIO; l++){
+      c->rq.head[l] = rq.head[l];
+      c->rq.tail[l] = rq.tail[l];
+    }
+    c->rq.rthead = rq.rthead;
+    c->rq.rttail = rq.rttail;
+    c->rq.n = rq.n;
+    release(&c->rq.lock);
+  }
+}
+#endif
+
+// Remove and return the next process to run from c's
+// queue, or 0 if it is empty.
+static struct proc*
+runqget(struct cpu *c)
+{
+  struct runq *rq = &c->rq;
+  struct proc *p;
+  struct cpu *oc;
+  int l;
+
+  for(;;){
+    acquire(&rq->lock);
+    p = runqpop(rq, &l);
+#ifdef SCHED_CFS
+    if(p && p->vruntime > rq->minvruntime)
+      rq->minvruntime = p->vruntime;
+#endif
+    release(&rq->lock);
+    if(p == 0 || allowed(p, c))
+      return p;
+
+    // p's affinity changed while it waited here.
+    oc = cpufor(p);
+    acquire(&oc->rq.lock);
+    runqpush(&oc->rq, p, l);
+    release(&oc->rq.lock);
+    if(oc->idle)
+      ipi(oc);
+  }
+}
+
+// Move processes from the longest other run queue to c's,
+// in the order that queue would have run them: half of them,
+// rounding up, if c is idle, otherwise half the difference
+// in length.
+// Returns the number moved.
+static int
+runqsteal(struct cpu *c, int idle)
+{
+  struct cpu *oc, *busiest = 0;
+  struct runq *rq = &c->rq, *brq, *kept = &c->kept;
+  struct proc *p;
+  int k, l, n;
+
+  // a racy look at the lengths is good enough to pick
+  // a victim; they are checked again under its lock.
+  for(oc = cpus; oc < &cpus[NCPU]; oc++){
+    if(oc != c && oc->rq.n > 0 &&
+       (busiest == 0 || oc->rq.n > busiest->rq.n))
+      busiest = oc;
+  }
+  if(busiest == 0)
+    return 0;
+
+  // lock the two queues in CPU order, so that two CPUs
+  // stealing from each other can't deadlock.
+  brq = &busiest->rq;
+  if(busiest < c){
+    acquire(&brq->lock);
+    acquire(&rq->lock);
+  } else {
+    acquire(&rq->lock);
+    acquire(&brq->lock);
+  }
+  if(idle)
+    k = (brq->n + 1) / 2;
+  else
+    k = (brq->n - rq->n) / 2;
+
+  // the stolen processes keep their p->cpu; it only
+  // matters once they have run, and scheduler() sets it.
+  // those whose affinity rules out c are kept aside.
+  memset(kept, 0, sizeof(*kept));
+  n = 0;
+  while(n < k && (p = runqpop(brq, &l)) != 0){
+    if(!allowed(p, c)){
+      runqpush(kept, p, l);
+      continue;
+    }
+    // keep its vruntime lead or lag relative to the queue (CFS).
+    p->vruntime = p->vruntime - brq->minvruntime + rq->minvruntime;
+    runqpush(rq, p, l);
+    n++;
+  }
+  if(kept->n > 0){
+    // put them back, in order.
+    while((p = runqpop(brq, &l)) != 0)
+      runqpush(kept, p, l);
+    while((p = runqpop(kept, &l)) != 0)
+      runqpush(brq, p, l);
+  }
+  rq->nstolen += n;
+  release(&brq->lock);
+  release(&rq->lock);
+  return n;
+}
+
+// Called by clockintr() on each tick of a CPU that is not
+// idle. Every BALANCE ticks, even out this CPU's run queue
+// with the busiest one, so that forked children don't all
+// wait on their parent's CPU.
+void
+rebalance(void)
+{
+  struct cpu *c = mycpu();
+
+  if(++c->nclock % BALANCE == 0)
+    runqsteal(c, 0);
+}
+
+// Report the length of each CPU's run queue and how much
+// work it has stolen, for the stats device.
+int
+statsrunq(char *buf, int sz)
+{
+  struct cpu *c;
+  int n;
+
+  n = snprintf(buf, sz, "--- run queues\n");
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    // harts that aren't running take no timer interrupts.
+    if(c->nclock == 0)
+      continue;
+    n += snprintf(buf+n, sz-n, "cpu %d: %d queued, %d stolen\n",
+                  (int)(c - cpus), c->rq.n, c->rq.nstolen);
+  }
+  return n;
+}
+
+// Count t in histogram hist.
+static void
+histadd(uint64 *hist, uint64 t)
+{
+  int k = 0;
+
+  while(t >>= 1)
+    k++;
+  if(k >= NHIST)
+    k = NHIST - 1;
+  hist[k]++;
+}
+
+static int
+statshist(char *buf, int sz, char *name, int id, uint64 *hist)
+{
+  int n, k;
+
+  n = snprintf(buf, sz, "cpu %d %s:", id, name);
+  for(k = 0; k < NHIST; k++){
+    if(hist[k])
+      n += snprintf(buf+n, sz-n, " %d:%d", k, (int)hist[k]);
+  }
+  n += snprintf(buf+n, sz-n, "\n");
+  return n;
+}
+
+// Report each CPU's histograms of how long processes waited
+// for it once RUNNABLE, and how long they then ran, for the
+// schedstats device. The counts are read without locks, so
+// may be a little out of step with one another.
+int
+statssched(char *buf, int sz)
+{
+  struct cpu *c;
+  int n;
+
+  n = snprintf(buf, sz, "--- scheduler latency: bucket:count, "
+               "bucket k for [2^k, 2^(k+1)) x %dns\n",
+               (int)time2ns(1));
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->online)
+      continue;
+    n += statshist(buf+n, sz-n, "wait", c - cpus, c->waithist);
+    n += statshist(buf+n, sz-n, "slice", c - cpus, c->slicehist);
+  }
+  return n;
+}
+
+// Nothing to run: stop c's clock ticks and wait in wfi
+// until an interrupt, such as makerunnable()'s IPI.
+static void
+idle(struct cpu *c)
+{
+  intr_off();
+  c->idle = 1;
+  // makerunnable() queues p and then looks at idle; we
+  // set idle and then look at the queues. So either it
+  // sends an IPI or we find p.
+  __sync_synchronize();
+  if(c->rq.n == 0 && runqsteal(c, 1) == 0){
+    wheelintr();
+    // wfi returns when an interrupt is pending, even
+    // with interrupts off.
+    asm volatile("wfi");
+  }
+  c->idle = 0;
+  // the missed tick is due at once.
+  wheelintr();
+}
+
+// Take p, which is RUNNABLE and off every queue, so no
+// one else will choose it, and make it c's process.
+// Returns with p->lock held; it is still held while a
+// CPU switching away from p saves its context.
+static void
+switchin(struct cpu *c, struct proc *p)
+{
+  acquire(&p->lock);
+  if(p->state != RUNNABLE)
+    panic("switchin: not runnable");
+  p->state = RUNNING;
+  p->cpu = c - cpus;
+  c->proc = p;
+  p->tstamp = r_time();
+  p->ontime = p->tstamp;
+  p->rtticks = 0;
+  p->throttled = 0;
+  histadd(c->waithist, p->ontime - p->readyat);
+#ifdef SCHED_CFS
+  p->runstart = p->tstamp;
+#endif
+}
+
+// p has been switched away from and its context saved, so
+// another CPU may now run it: queue it again if it yield()ed,
+// and release the lock it held through the switch.
+static void
+switchout(struct proc *p)
+{
+#ifdef SCHED_CFS
+  account(p);
+#endif
+  uint64 now = r_time();
+
+  p->usage.stime += now - p->tstamp;
+  histadd(mycpu()->slicehist, now - p->ontime);
+  if(p->state == RUNNABLE){
+    p->usage.nivcsw++;
+    makerunnable(p);
+  } else {
+    p->usage.nvcsw++;
+  }
+  release(&p->lock);
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - take a process from this CPU's run queue, first
+//    stealing from the busiest CPU if this one's is empty.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
@@ -448,41 +1416,40 @@ scheduler(void)
   struct cpu *c = mycpu();
 
   c->proc = 0;
+  c->online = 1;
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
     // processes are waiting.
     intr_on();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
-      }
-      release(&p->lock);
-    }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
-      intr_on();
-      asm volatile("wfi");
+    p = runqget(c);
+    if(p == 0 && runqsteal(c, 1) > 0)
+      p = runqget(c);
+    if(p == 0) {
+      idle(c);
+      continue;
     }
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    switchin(c, p);
+    swtch(&c->context, &p->context);
+
+    // The process running now is done for now. It may
+    // not be p, if p switched straight to another.
+    // It should have changed its p->state before coming back.
+    p = c->proc;
+    c->proc = 0;
+    switchout(p);
   }
 }
 
-// Switch to scheduler.  Must hold only p->lock
-// and have changed proc->state. Saves and restores
-// intena because intena is a property of this
+// Switch straight to the next process in this CPU's run
+// queue, or to the scheduler if there is none. Must hold
+// only p->lock and have changed proc->state. Saves and
+// restores intena because intena is a property of this
 // kernel thread, not this CPU. It should
 // be proc->intena and proc->noff, but that would
 // break in the few places where a lock is held but
@@ -491,28 +1458,107 @@ void
 sched(void)
 {
   int intena;
-  struct proc *p = myproc();
+  struct proc *p = myproc(), *np;
+  struct cpu *c = mycpu();
 
   if(!holding(&p->lock))
     panic("sched p->lock");
-  if(mycpu()->noff != 1)
+  if(c->noff != 1)
     panic("sched locks");
   if(p->state == RUNNING)
     panic("sched running");
   if(intr_get())
     panic("sched interruptible");
 
-  intena = mycpu()->intena;
-  swtch(&p->context, &mycpu()->context);
+  intena = c->intena;
+  np = runqget(c);
+  if(np == 0 && p->state == RUNNABLE && allowed(p, c)){
+    // yield()ing, with nothing else to run.
+    p->state = RUNNING;
+    return;
+  }
+  if(np){
+    // p's lock is held until np has switched in, when
+    // finishswitch() queues p if need be.
+    c->prev = p;
+    switchin(c, np);
+    swtch(&p->context, &np->context);
+  } else {
+    swtch(&p->context, &c->context);
+  }
   mycpu()->intena = intena;
+  finishswitch();
+}
+
+// The first thing a process does once switched to, in
+// sched() or forkret(): finish switching away from the
+// process that sched() switched straight from, if any.
+static void
+finishswitch(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *prev = c->prev;
+
+  if(prev){
+    c->prev = 0;
+    switchout(prev);
+  }
 }
 
 // Give up the CPU for one scheduling round.
+// Called on timer interrupts, and by setaffinity().
 void
 yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
+  struct cpu *c = mycpu();
+  // p can't run on here if its affinity has changed.
+  int stay = allowed(p, c);
+
+  if(isrt(p)){
+    // a real-time process runs until it blocks, except
+    // that every RTLIMIT ticks it waits once behind the
+    // others, as though SCHED_OTHER.
+    if(++p->rtticks < RTLIMIT && stay){
+      release(&p->lock);
+      return;
+    }
+    if(p->rtticks >= RTLIMIT)
+      p->throttled = 1;
+    p->state = RUNNABLE;
+    sched();
+    release(&p->lock);
+    return;
+  }
+  // a waiting real-time process preempts p.
+  if(c->rq.rthead)
+    stay = 0;
+#ifdef SCHED_MLFQ
+  // run on until p has used up its quantum at this
+  // level, unless something more important is waiting.
+  catchup(p);
+  if(++p->qticks < (QUANTUM << p->level) && stay &&
+     !runqbetter(&c->rq, p->level)){
+    release(&p->lock);
+    return;
+  }
+  if(p->qticks >= (QUANTUM << p->level)){
+    // used a whole quantum: demote.
+    p->qticks = 0;
+    if(p->level < NPRIO - 1)
+      p->level++;
+  }
+#endif
+#ifdef SCHED_CFS
+  // run on until a waiting process has fallen behind.
+  account(p);
+  if(stay && !runqbehind(&c->rq, p->vruntime)){
+    release(&p->lock);
+    return;
+  }
+#endif
+  // sched() queues p once it has switched away.
   p->state = RUNNABLE;
   sched();
   release(&p->lock);
@@ -525,7 +1571,8 @@ forkret(void)
 {
   static int first = 1;
 
-  // Still holding p->lock from scheduler.
+  // Still holding p->lock from scheduler() or sched().
+  finishswitch();
   release(&myproc()->lock);
 
   if (first) {
@@ -542,53 +1589,120 @@ forkret(void)
   usertrapret();
 }
 
+static struct waitq*
+waitqfor(void *chan)
+{
+  return &waitq[((uint64)chan >> 3) % NWAITQ];
+}
+
+// Take p off wq. Caller must hold wq->lock.
+static void
+waitqremove(struct waitq *wq, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &wq->head; *pp; pp = &(*pp)->wqnext){
+    if(*pp == p){
+      *pp = p->wqnext;
+      break;
+    }
+  }
+  p->wqnext = 0;
+  p->wq = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = waitqfor(chan);
+  struct proc **pp;
   
-  // Must acquire p->lock in order to
-  // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Must acquire wq->lock in order to join chan's
+  // wait queue, and p->lock in order to change
+  // p->state and then call sched.
+  // Once we hold wq->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks wq->lock),
   // so it's okay to release lk.
 
-  acquire(&p->lock);  //DOC: sleeplock1
+  acquire(&wq->lock);  //DOC: sleeplock1
   release(lk);
+  acquire(&p->lock);
 
-  // Go to sleep.
+  // Go to sleep, at the tail of the queue.
   p->chan = chan;
   p->state = SLEEPING;
+  for(pp = &wq->head; *pp; pp = &(*pp)->wqnext)
+    ;
+  *pp = p;
+  p->wqnext = 0;
+  p->wq = wq;
+  release(&wq->lock);
 
   sched();
 
-  // Tidy up.
+  // Tidy up. kill() wakes p without taking it off the queue.
+  release(&p->lock);
+  acquire(&wq->lock);
+  if(p->wq)
+    waitqremove(wq, p);
   p->chan = 0;
+  release(&wq->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
+// Wake up at most n processes sleeping on chan, longest
+// asleep first, or all of them if n < 0.
+// Returns how many were woken.
+// Must be called without any p->lock.
+int
+wakeup_n(void *chan, int n)
+{
+  struct waitq *wq = waitqfor(chan);
+  struct proc *p, *next;
+  int woken, nwoken = 0;
+
+  acquire(&wq->lock);
+  for(p = wq->head; p && nwoken != n; p = next){
+    next = p->wqnext;
+    if(p->chan != chan)
+      continue;
+    waitqremove(wq, p);
+    // p may have been kill()ed awake already.
+    acquire(&p->lock);
+    woken = p->state == SLEEPING;
+    if(woken){
+      makerunnable(p);
+      nwoken++;
+    }
+    release(&p->lock);
+  }
+  release(&wq->lock);
+  return nwoken;
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  wakeup_n(chan, -1);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-    }
-  }
+// Wake up the process that has slept longest on chan,
+// for sites where one waiter can use what's available.
+// A waiter woken this way that then gives up must pass
+// the wakeup on.
+// Must be called without any p->lock.
+void
+wakeup_one(void *chan)
+{
+  wakeup_n(chan, 1);
 }
 
 // Kill the process with the given pid.
@@ -599,20 +1713,139 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    makerunnable(p);
+  }
+  release(&p->lock);
+  return 0;
+}
+
+// Set the priority of process pid, or of the caller if pid
+// is 0: the best run queue level it may use, clamped to
+// 0 (the default) through NPRIO-1. Children inherit it.
+// The MLFQ scheduler uses it as a level, and the CFS
+// scheduler as a weight; round-robin ignores it.
+// Returns 0, or -1 if there is no such process.
+int
+setpriority(int pid, int prio)
+{
+  struct proc *p;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if(prio < 0)
+    prio = 0;
+  if(prio >= NPRIO)
+    prio = NPRIO - 1;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->prio = prio;
+#ifdef SCHED_MLFQ
+  p->level = prio;
+  p->qticks = 0;
+#endif
+  release(&p->lock);
+  return 0;
+}
+
+// Set the scheduling policy of process pid, or of the
+// caller if pid is 0, to SCHED_OTHER or SCHED_FIFO.
+// Children inherit it.
+// Returns the old policy, or -1 if there is no such
+// process or policy.
+int
+setscheduler(int pid, int policy)
+{
+  struct proc *p;
+  int old;
+
+  if(policy != SCHED_OTHER && policy != SCHED_FIFO)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  old = p->policy;
+  p->policy = policy;
+  p->rtticks = 0;
+  p->throttled = 0;
+  release(&p->lock);
+  return old;
+}
+
+// Restrict process pid, or the caller if pid is 0, to the
+// CPUs in mask (bit i for CPU i). Children inherit it.
+// Returns 0, or -1 if there is no such process or mask
+// has no CPU that is running.
+int
+setaffinity(int pid, int mask)
+{
+  struct proc *p;
+  struct cpu *c;
+  int online = 0;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->online)
+      online |= 1 << (c - cpus);
   }
-  return -1;
+  mask &= ALLCPUS;
+  if((mask & online) == 0)
+    return -1;
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->affinity = mask;
+  release(&p->lock);
+
+  // a process running elsewhere moves at its next yield(),
+  // and a waiting one when its CPU next looks at it.
+  if(p == myproc())
+    yield();
+  return 0;
+}
+
+// Return the affinity mask of process pid, or of the
+// caller if pid is 0, or -1 if there is no such process.
+int
+getaffinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  mask = p->affinity;
+  release(&p->lock);
+  return mask;
+}
+
+// Return the priority of process pid, or of the caller if
+// pid is 0, or -1 if there is no such process.
+int
+getpriority(int pid)
+{
+  struct proc *p;
+  int prio;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  prio = p->prio;
+  release(&p->lock);
+  return prio;
 }
 
 void
@@ -682,7 +1915,7 @@ procdump(void)
   char *state;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(p = allprocs; p; p = p->allnext){
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
@@ -690,6 +1923,8 @@ procdump(void)
     else
       state = "???";
     printf("%d %s %s", p->pid, state, p->name);
+    printf(" user %lums sys %lums", time2ns(p->usage.utime) / 1000000,
+           time2ns(p->usage.stime) / 1000000);
     printf("\n");
   }
 }
@@ -18,12 +18,58 @@ struct context {
   uint64 s11;
 };
 
+// RUNNABLE processes waiting for a CPU: a FIFO list per
+// priority level, linked through p->rqnext. Level 0 runs
+// first; only the MLFQ scheduler uses the others. The CFS
+// scheduler keeps a heap ordered by vruntime instead.
+// SCHED_FIFO processes wait in a list ahead of them all.
+struct runq {
+  struct spinlock lock;
+  struct proc *rthead;        // next SCHED_FIFO process to run
+  struct proc *rttail;
+#ifdef SCHED_CFS
+  struct proc *heap[NPROC];   // heap[0] has the least vruntime
+  int nheap;                  // processes in heap
+#else
+  struct proc *head[NPRIO];   // next to run at each level
+  struct proc *tail[NPRIO];
+#endif
+  uint64 minvruntime;         // vruntime of the last process chosen (CFS)
+  int n;                      // number of processes queued
+  int nstolen;                // processes taken from other queues
+};
+
+// A timer armed by wheelsleep() on a CPU's timer wheel.
+struct timer {
+  uint64 deadline;            // r_time() at which it expires
+  struct wheel *wheel;        // wheel it is on, or 0 once expired
+  struct timer **slot;        // wheel slot it is on
+  struct timer *next;         // next in slot
+  int level;                  // wheel level of slot
+};
+
+// Latency histograms have a bucket for each power of two
+// r_time() units: bucket k counts times in [2^k, 2^(k+1)).
+#define NHIST 32
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
+  struct proc *prev;          // Process sched() just switched from, still locked.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct runq rq;             // Processes waiting to run on this cpu.
+  struct runq kept;           // runqsteal()'s scratch queue (rq.lock).
+  int online;                 // Has entered scheduler().
+  uint nclock;                // Clock ticks taken, for rebalance().
+  uint64 nexttick;            // r_time() of the next clock tick.
+  int idle;                   // In idle(), with clock ticks stopped.
+  pagetable_t upagetable;     // User page table while in user space, else 0.
+  int resched;                // makerunnable() IPIed to preempt for SCHED_FIFO.
+  int tlbflush;               // tlbshootdown() awaits a trap.
+  uint64 waithist[NHIST];     // Time from RUNNABLE to running here.
+  uint64 slicehist[NHIST];    // Time run here before switching away.
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +127,25 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// CPU time, in r_time() units, and events, for getrusage().
+struct cputime {
+  uint64 utime;               // In user space
+  uint64 stime;               // In the kernel
+  uint64 nvcsw;               // Switches away while not RUNNABLE
+  uint64 nivcsw;              // Switches away while RUNNABLE
+  uint64 nfault;              // Page faults
+};
+
+// Open files and current directory, shared by the
+// threads of a process.
+struct files {
+  struct spinlock lock;
+  int ref;                     // Threads using this table
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+  struct files *next;          // Next on free list (files_lock)
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -91,9 +156,45 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // CPU whose run queue p goes on
+  int affinity;                // Mask of CPUs p may run on
+  struct proc *rqnext;         // Next in run queue (rq->lock)
+  struct waitq *wq;            // Wait queue p sleeps on, or 0 (wq->lock)
+  struct proc *wqnext;         // Next in wait queue (wq->lock)
+  int prio;                    // Best level p may run at, from setpriority()
+  int level;                   // Run queue level
+  int qticks;                  // Ticks used at this level (MLFQ)
+  uint boosted;                // Boosts applied to level, of boostepoch (MLFQ)
+  uint64 vruntime;             // Weighted CPU time used (CFS)
+  uint64 runstart;             // When vruntime was last charged (CFS)
+  uint64 readyat;              // r_time() when last made RUNNABLE
+  int policy;                  // SCHED_OTHER or SCHED_FIFO
+  int rtticks;                 // Ticks run as SCHED_FIFO since switched in
+  int throttled;               // SCHED_FIFO, but waiting as SCHED_OTHER
+  uint64 ontime;               // r_time() when last switched in
+  struct timer timer;          // For wheelsleep() (wheel lock)
+
+  // pid_lock must be held when using these:
+  struct proc *next;           // Next in pid hash chain or free list
+  int hashpid;                 // pid p is hashed under
+
+  // thread_lock must be held when using these:
+  struct proc *tnext;          // Next thread sharing p->pagetable, or p
+  int tslot;                   // Slot of p's trapframe, for THREADFRAME()
 
-  // wait_lock must be held when using this:
+  // fixed once procslab() makes p:
+  struct proc *allnext;        // Next of all procs ever made
+
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // First child
+  struct proc *sibling;        // Next child of parent
+  struct cputime cusage;       // Of children waited for
+
+  // charged by p's own CPU as p runs: at the user/kernel
+  // boundary in trap.c, and at switches with p->lock held.
+  struct cputime usage;
+  uint64 tstamp;               // r_time() when last charged
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
@@ -101,7 +202,6 @@ struct proc {
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
-  struct inode *cwd;           // Current directory
+  struct files *files;         // Open files and current directory
   char name[16];               // Process name (debugging)
 };
@@ -0,0 +1,10 @@
+#define RUSAGE_SELF      0   // the calling process
+#define RUSAGE_CHILDREN  (-1) // its children that have been waited for
+
+struct rusage {
+  uint64 utime;   // CPU time in user space, in nanoseconds
+  uint64 stime;   // CPU time in the kernel, in nanoseconds
+  uint64 nvcsw;   // Voluntary context switches: sleeps and exits
+  uint64 nivcsw;  // Involuntary context switches: preemptions
+  uint64 nfault;  // Page faults
+};
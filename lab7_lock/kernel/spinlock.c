@@ -9,7 +9,7 @@
 #include "defs.h"
 
 #ifdef LAB_LOCK
-#define NLOCK 500
+#define NLOCK (2*NPROC + 500)  // each proc and descriptor table has a lock
 
 static struct spinlock *locks[NLOCK];
 struct spinlock lock_locks;
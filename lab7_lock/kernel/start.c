@@ -6,10 +6,17 @@
 
 void main();
 void timerinit();
+void ipiinit();
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
+// a scratch area per CPU for machine-mode interrupts.
+uint64 ipi_scratch[NCPU][2];
+
+// in kernelvec.S, forwards IPIs to supervisor mode.
+extern void machinevec();
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
@@ -45,6 +52,9 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // take IPIs from other harts.
+  ipiinit();
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -67,5 +77,19 @@ timerinit()
   w_mcounteren(r_mcounteren() | 2);
   
   // ask for the very first timer interrupt.
-  w_stimecmp(r_time() + 1000000);
+  w_stimecmp(r_time() + TICK);
+}
+
+// an IPI is a machine-mode software interrupt, raised by
+// writing the target hart's CLINT MSIP register. it can't
+// be delegated, so machinevec turns it into a supervisor
+// software interrupt.
+void
+ipiinit()
+{
+  int id = r_mhartid();
+
+  w_mscratch((uint64)&ipi_scratch[id][0]);
+  w_mtvec((uint64)machinevec);
+  w_mie(r_mie() | MIE_MSIE);
 }
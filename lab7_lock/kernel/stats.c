@@ -10,15 +10,21 @@
 #include "defs.h"
 
 #define BUFSZ 4096
-static struct {
+struct statsbuf {
   struct spinlock lock;
   char buf[BUFSZ];
   int sz;
   int off;
-} stats;
+};
+static struct statsbuf stats;
+#ifdef LAB_LOCK
+static struct statsbuf schedstats;
+#endif
 
 int statscopyin(char*, int);
 int statslock(char*, int);
+int statsrunq(char*, int);
+int statssched(char*, int);
   
 int
 statswrite(int user_src, uint64 src, int n)
@@ -26,38 +32,66 @@ statswrite(int user_src, uint64 src, int n)
   return -1;
 }
 
-int
-statsread(int user_dst, uint64 dst, int n)
+// Copy out the next n bytes of the text that fill() writes
+// into s->buf, calling it afresh once the last read has
+// reached the end.
+static int
+statsreadbuf(struct statsbuf *s, int (*fill)(char*, int),
+             int user_dst, uint64 dst, int n)
 {
   int m;
 
-  acquire(&stats.lock);
+  acquire(&s->lock);
 
-  if(stats.sz == 0) {
-#ifdef LAB_PGTBL
-    stats.sz = statscopyin(stats.buf, BUFSZ);
-#endif
-#ifdef LAB_LOCK
-    stats.sz = statslock(stats.buf, BUFSZ);
-#endif
+  if(s->sz == 0) {
+    s->sz = fill(s->buf, BUFSZ);
   }
-  m = stats.sz - stats.off;
+  m = s->sz - s->off;
 
   if (m > 0) {
     if(m > n)
       m  = n;
-    if(either_copyout(user_dst, dst, stats.buf+stats.off, m) != -1) {
-      stats.off += m;
+    if(either_copyout(user_dst, dst, s->buf+s->off, m) != -1) {
+      s->off += m;
     }
   } else {
     m = -1;
-    stats.sz = 0;
-    stats.off = 0;
+    s->sz = 0;
+    s->off = 0;
   }
-  release(&stats.lock);
+  release(&s->lock);
   return m;
 }
 
+static int
+statsfill(char *buf, int sz)
+{
+  int n = 0;
+
+#ifdef LAB_PGTBL
+  n = statscopyin(buf, sz);
+#endif
+#ifdef LAB_LOCK
+  n = statslock(buf, sz);
+  n += statsrunq(buf + n, sz - n);
+#endif
+  return n;
+}
+
+int
+statsread(int user_dst, uint64 dst, int n)
+{
+  return statsreadbuf(&stats, statsfill, user_dst, dst, n);
+}
+
+#ifdef LAB_LOCK
+int
+schedstatsread(int user_dst, uint64 dst, int n)
+{
+  return statsreadbuf(&schedstats, statssched, user_dst, dst, n);
+}
+#endif
+
 void
 statsinit(void)
 {
@@ -65,5 +99,11 @@ statsinit(void)
 
   devsw[STATS].read = statsread;
   devsw[STATS].write = statswrite;
+
+#ifdef LAB_LOCK
+  initlock(&schedstats.lock, "schedstats");
+  devsw[SCHEDSTATS].read = schedstatsread;
+  devsw[SCHEDSTATS].write = statswrite;
+#endif
 }
 
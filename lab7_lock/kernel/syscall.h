@@ -20,3 +20,15 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_setpriority 22
+#define SYS_getpriority 23
+#define SYS_nsleep 24
+#define SYS_waitpid 25
+#define SYS_setaffinity 26
+#define SYS_getaffinity 27
+#define SYS_clone  28
+#define SYS_futex_wait 29
+#define SYS_futex_wake 30
+#define SYS_getrusage 31
+#define SYS_setscheduler 32
+#define SYS_clock_gettime 33
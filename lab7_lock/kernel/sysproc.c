@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "time.h"
 
 uint64
 sys_exit(void)
@@ -27,6 +28,50 @@ sys_fork(void)
   return fork();
 }
 
+uint64
+sys_clone(void)
+{
+  uint64 fn, stack, arg;
+
+  argaddr(0, &fn);
+  argaddr(1, &stack);
+  argaddr(2, &arg);
+  return clone(fn, stack, arg);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+
+  argaddr(0, &addr);
+  argint(1, &val);
+  return futexwait(addr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return futexwake(addr, n);
+}
+
+uint64
+sys_getrusage(void)
+{
+  int who;
+  uint64 addr;
+
+  argint(0, &who);
+  argaddr(1, &addr);
+  return getrusage(who, addr);
+}
+
 uint64
 sys_wait(void)
 {
@@ -35,6 +80,18 @@ sys_wait(void)
   return wait(p);
 }
 
+uint64
+sys_waitpid(void)
+{
+  int pid, options;
+  uint64 p;
+
+  argint(0, &pid);
+  argaddr(1, &p);
+  argint(2, &options);
+  return waitpid(pid, p, options);
+}
+
 uint64
 sys_sbrk(void)
 {
@@ -52,21 +109,46 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
   if(n < 0)
     n = 0;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
+  return wheelsleep(r_time() + (uint64)n * TICK);
+}
+
+// sleep for at least the given number of nanoseconds.
+uint64
+sys_nsleep(void)
+{
+  uint64 ns, t, now;
+
+  argaddr(0, &ns);
+  t = ns2time(ns);
+  now = r_time();
+  // a deadline past the end of time sleeps until killed,
+  // rather than wrapping into the past.
+  if(t > ~0UL - now)
+    return wheelsleep(~0UL);
+  return wheelsleep(now + t);
+}
+
+// read clock clk into the struct timespec at addr.
+uint64
+sys_clock_gettime(void)
+{
+  int clk;
+  uint64 addr, ns;
+  struct timespec ts;
+
+  argint(0, &clk);
+  argaddr(1, &addr);
+  if(clk != CLOCK_MONOTONIC)
+    return -1;
+  ns = nsecs();
+  ts.tv_sec = ns / 1000000000;
+  ts.tv_nsec = ns % 1000000000;
+  if(copyout(myproc()->pagetable, addr, (char *)&ts, sizeof(ts)) < 0)
+    return -1;
   return 0;
 }
 
@@ -79,6 +161,54 @@ sys_kill(void)
   return kill(pid);
 }
 
+uint64
+sys_setpriority(void)
+{
+  int pid, prio;
+
+  argint(0, &pid);
+  argint(1, &prio);
+  return setpriority(pid, prio);
+}
+
+uint64
+sys_getpriority(void)
+{
+  int pid;
+
+  argint(0, &pid);
+  return getpriority(pid);
+}
+
+uint64
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  argint(0, &pid);
+  argint(1, &mask);
+  return setaffinity(pid, mask);
+}
+
+uint64
+sys_setscheduler(void)
+{
+  int pid, policy;
+
+  argint(0, &pid);
+  argint(1, &policy);
+  return setscheduler(pid, policy);
+}
+
+uint64
+sys_getaffinity(void)
+{
+  int pid;
+
+  argint(0, &pid);
+  return getaffinity(pid);
+}
+
 // return how many clock tick interrupts have occurred
 // since start.
 uint64
@@ -0,0 +1,7 @@
+// clock_gettime() clocks
+#define CLOCK_MONOTONIC 1   // time since boot, from the time CSR
+
+struct timespec {
+  uint64 tv_sec;    // seconds
+  uint64 tv_nsec;   // and nanoseconds, less than 1000000000
+};
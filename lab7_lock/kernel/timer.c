@@ -0,0 +1,274 @@
+// Timers for sleeping processes.
+//
+// Each CPU keeps a hierarchical timer wheel of the timers
+// armed on it. Level 0 has WHEELSIZE slots of 1<<SLOTSHIFT
+// time units each; each level up has slots WHEELSIZE times
+// as wide. A timer goes in the lowest level whose span covers
+// its deadline, and moves down a level (cascades) when the
+// wheel's clock reaches its slot, so that arming, cancelling
+// and expiring a timer take constant time.
+//
+// stimecmp is programmed for the earlier of the next clock
+// tick and the earliest timer deadline, so a sleeper is woken
+// at its deadline rather than at the next tick. An idle CPU
+// takes no clock ticks, only its timers' deadlines.
+//
+// Interface:
+// * wheelsleep() arms a timer for the current process and
+//     sleeps until it expires.
+// * clockintr() calls wheelintr() on every timer interrupt,
+//     and idle() when the CPU stops or restarts ticking.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define WHEELBITS 6
+#define WHEELSIZE (1 << WHEELBITS)
+#define WHEELMASK (WHEELSIZE - 1)
+#define NLEVEL    4
+#define SLOTSHIFT 12              // level 0 slots are ~410us wide
+
+struct wheel {
+  struct spinlock lock;
+  uint64 clock;                   // current level 0 slot, in slot units
+  struct timer *slot[NLEVEL][WHEELSIZE];
+  int n[NLEVEL];                  // timers at each level
+};
+
+struct wheel wheels[NCPU];
+
+void
+wheelinit(void)
+{
+  struct wheel *w;
+
+  for(w = wheels; w < &wheels[NCPU]; w++){
+    initlock(&w->lock, "wheel");
+    w->clock = r_time() >> SLOTSHIFT;
+  }
+}
+
+// Put t in the slot for its deadline.
+static void
+wheeladd(struct wheel *w, struct timer *t)
+{
+  uint64 when = t->deadline >> SLOTSHIFT;
+  uint64 delta;
+  int level;
+
+  if(when < w->clock)
+    when = w->clock;
+  delta = when - w->clock;
+  for(level = 0; level < NLEVEL-1; level++){
+    if(delta < (1L << (WHEELBITS * (level+1))))
+      break;
+  }
+  if(delta >= (1L << (WHEELBITS * NLEVEL)))
+    when = w->clock + (1L << (WHEELBITS * NLEVEL)) - 1; // re-filed on cascade
+  t->slot = &w->slot[level][(when >> (WHEELBITS * level)) & WHEELMASK];
+  t->level = level;
+  t->next = *t->slot;
+  *t->slot = t;
+  t->wheel = w;
+  w->n[level]++;
+}
+
+static void
+wheelremove(struct wheel *w, struct timer *t)
+{
+  struct timer **tp;
+
+  for(tp = t->slot; *tp; tp = &(*tp)->next){
+    if(*tp == t){
+      *tp = t->next;
+      break;
+    }
+  }
+  w->n[t->level]--;
+  t->wheel = 0;
+}
+
+// Expire the timers in slot that are due by now.
+static void
+wheelfire(struct wheel *w, struct timer **slot, uint64 now)
+{
+  struct timer *t, *next;
+
+  for(t = *slot; t; t = next){
+    next = t->next;
+    if(t->deadline <= now){
+      wheelremove(w, t);
+      wakeup(t);
+    }
+  }
+}
+
+// The clock has entered a new level 0 rotation: move the
+// timers of each higher level's current slot down.
+static void
+wheelcascade(struct wheel *w)
+{
+  struct timer *t, *next;
+  int level, i;
+
+  for(level = 1; level < NLEVEL; level++){
+    i = (w->clock >> (WHEELBITS * level)) & WHEELMASK;
+    t = w->slot[level][i];
+    w->slot[level][i] = 0;
+    for(; t; t = next){
+      next = t->next;
+      w->n[level]--;
+      wheeladd(w, t);
+    }
+    if(i != 0)
+      break;
+  }
+}
+
+// Advance w's clock to now, expiring timers on the way.
+static void
+wheeladvance(struct wheel *w, uint64 now)
+{
+  uint64 target = now >> SLOTSHIFT;
+  uint64 step;
+  int level;
+
+  while(w->clock < target){
+    wheelfire(w, &w->slot[0][w->clock & WHEELMASK], now);
+    // skip rotations of levels that are empty.
+    for(level = 0; level < NLEVEL; level++){
+      if(w->n[level])
+        break;
+    }
+    if(level == NLEVEL){
+      w->clock = target;
+      break;
+    }
+    step = 1L << (WHEELBITS * level);
+    w->clock = (w->clock | (step - 1)) + 1;
+    if(w->clock > target){
+      w->clock = target;
+      break;
+    }
+    if((w->clock & WHEELMASK) == 0)
+      wheelcascade(w);
+  }
+  wheelfire(w, &w->slot[0][w->clock & WHEELMASK], now);
+}
+
+// Earliest deadline of the timers on w, or ~0 if none.
+static uint64
+wheelnext(struct wheel *w)
+{
+  struct timer *t;
+  uint64 next = ~0L;
+  int level, i, start;
+
+  for(level = 0; level < NLEVEL; level++){
+    if(w->n[level] == 0)
+      continue;
+    // the first non-empty slot holds the level's earliest.
+    // a higher level's current slot has been cascaded, so
+    // anything there now is a whole rotation away.
+    start = (w->clock >> (WHEELBITS * level)) & WHEELMASK;
+    if(level > 0)
+      start++;
+    for(i = 0; i < WHEELSIZE; i++){
+      t = w->slot[level][(start + i) & WHEELMASK];
+      if(t == 0)
+        continue;
+      for(; t; t = t->next){
+        if(t->deadline < next)
+          next = t->deadline;
+      }
+      break;
+    }
+  }
+  return next;
+}
+
+// Ask for a timer interrupt at the next tick or deadline.
+// Caller holds w->lock, with w this CPU's wheel.
+static void
+wheelprogram(struct wheel *w)
+{
+  struct cpu *c = mycpu();
+  uint64 next = wheelnext(w);
+
+  if(!c->idle && c->nexttick < next)
+    next = c->nexttick;
+  w_stimecmp(next);
+}
+
+// Expire this CPU's due timers and set up the
+// next timer interrupt. Called with interrupts off.
+void
+wheelintr(void)
+{
+  struct wheel *w = &wheels[cpuid()];
+
+  acquire(&w->lock);
+  wheeladvance(w, r_time());
+  wheelprogram(w);
+  release(&w->lock);
+}
+
+// Convert t time CSR units to nanoseconds.
+uint64
+time2ns(uint64 t)
+{
+  return t / TIMEFREQ * 1000000000 + t % TIMEFREQ * 1000000000 / TIMEFREQ;
+}
+
+// Convert ns nanoseconds to time CSR units, rounding up.
+uint64
+ns2time(uint64 ns)
+{
+  return ns / 1000000000 * TIMEFREQ +
+    (ns % 1000000000 * TIMEFREQ + 1000000000 - 1) / 1000000000;
+}
+
+// Nanoseconds since boot, from the time CSR.
+uint64
+nsecs(void)
+{
+  return time2ns(r_time());
+}
+
+// Sleep until r_time() reaches deadline.
+// Returns -1 if killed first.
+int
+wheelsleep(uint64 deadline)
+{
+  struct proc *p = myproc();
+  struct timer *t = &p->timer;
+  struct wheel *w;
+
+  if(deadline <= r_time())
+    return 0;
+
+  // the timer goes on this CPU's wheel, even if p
+  // later wakes up on another CPU.
+  push_off();
+  w = &wheels[cpuid()];
+  acquire(&w->lock);
+  pop_off();
+  t->deadline = deadline;
+  wheeladd(w, t);
+  wheelprogram(w);
+  while(t->wheel){
+    if(killed(p)){
+      wheelremove(w, t);
+      release(&w->lock);
+      return -1;
+    }
+    sleep(t, &w->lock);
+  }
+  release(&w->lock);
+  return 0;
+}
@@ -8,6 +8,7 @@
 
 struct spinlock tickslock;
 uint ticks;
+uint64 tickdue;   // r_time() at which ticks is next due
 
 extern char trampoline[], uservec[], userret[];
 
@@ -20,6 +21,7 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  tickdue = r_time() + TICK;
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -45,7 +47,17 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  // uservec flushed the TLB; tell tlbshootdown().
+  struct cpu *c = mycpu();
+  c->upagetable = 0;
+  __atomic_store_n(&c->tlbflush, 0, __ATOMIC_RELEASE);
+
   struct proc *p = myproc();
+
+  // charge the time since usertrapret() to user space.
+  uint64 now = r_time();
+  p->usage.utime += now - p->tstamp;
+  p->tstamp = now;
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
@@ -68,6 +80,8 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
+    if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15)
+      p->usage.nfault++;
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", r_scause(), p->pid);
     printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
     setkilled(p);
@@ -119,9 +133,20 @@ usertrapret(void)
   // set S Exception Program Counter to the saved user pc.
   w_sepc(p->trapframe->epc);
 
-  // tell trampoline.S the user page table to switch to.
+  // tell trampoline.S where this thread's trapframe is
+  // mapped, and the user page table to switch to.
+  w_sscratch(THREADFRAME(p->tslot));
   uint64 satp = MAKE_SATP(p->pagetable);
 
+  // from here on, tlbshootdown() must wait for this hart.
+  mycpu()->upagetable = p->pagetable;
+  __sync_synchronize();
+
+  // charge the time since usertrap() or switchin() to the kernel.
+  uint64 now = r_time();
+  p->usage.stime += now - p->tstamp;
+  p->tstamp = now;
+
   // jump to userret in trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
@@ -160,20 +185,44 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
+// a timer interrupt: either a clock tick or a
+// wheelsleep() deadline. returns 1 if a tick.
+int
 clockintr()
 {
-  if(cpuid() == 0){
+  struct cpu *c = mycpu();
+  int tick = r_time() >= c->nexttick;
+
+  if(tick){
+    // TICK is 1/HZ seconds.
+    c->nexttick = r_time() + TICK;
+
+    // any CPU that is ticking keeps ticks up to date,
+    // catching up on ticks missed while all were idle.
     acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
+#ifdef SCHED_MLFQ
+    int b = 0;
+#endif
+    while(r_time() >= tickdue){
+      ticks++;
+      tickdue += TICK;
+#ifdef SCHED_MLFQ
+      b |= ticks % BOOST == 0;
+#endif
+    }
     release(&tickslock);
+#ifdef SCHED_MLFQ
+    if(b)
+      boost();
+#endif
+
+    rebalance();
   }
 
-  // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // wake sleepers that are due, and ask for the next
+  // timer interrupt. this also clears the interrupt request.
+  wheelintr();
+  return tick;
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -206,11 +255,24 @@ devintr()
     if(irq)
       plic_complete(irq);
 
+    return 1;
+  } else if(scause == 0x8000000000000001L){
+    // software interrupt: an IPI forwarded by machinevec,
+    // which just wakes an idle CPU, or, by trapping from
+    // user space, answers tlbshootdown(). if makerunnable()
+    // queued a SCHED_FIFO process, treat it like a tick so
+    // that the caller yields.
+    w_sip(r_sip() & ~2);
+    if(mycpu()->resched){
+      mycpu()->resched = 0;
+      return 2;
+    }
     return 1;
   } else if(scause == 0x8000000000000005L){
     // timer interrupt.
-    clockintr();
-    return 2;
+    if(clockintr())
+      return 2;
+    return 1;
   } else {
     return 0;
   }
@@ -178,7 +178,7 @@ free_desc(int i)
   disk.desc[i].flags = 0;
   disk.desc[i].next = 0;
   disk.free[i] = 1;
-  wakeup(&disk.free[0]);
+  wakeup_one(&disk.free[0]);
 }
 
 // free a chain of descriptors.
@@ -30,6 +30,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, for sending IPIs
+  kvmmap(kpgtbl, CLINT, CLINT, PGSIZE, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
@@ -43,9 +46,8 @@ kvmmake(void)
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // allocate and map a kernel stack for each process.
-  proc_mapstacks(kpgtbl);
-  
+  // kernel stacks are mapped as procslab() makes processes.
+
   return kpgtbl;
 }
 
@@ -273,6 +275,38 @@ uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
   return newsz;
 }
 
+// Like uvmdealloc(), for a page table that threads on other
+// harts may be using: a page is freed only after
+// tlbshootdown() has flushed it from their TLBs. Pages are
+// unmapped in batches of NBATCH, with one shootdown each.
+#define NBATCH 32
+uint64
+uvmshrink(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
+{
+  uint64 a, batch[NBATCH];
+  pte_t *pte;
+  int i, n = 0;
+
+  if(newsz >= oldsz)
+    return oldsz;
+
+  for(a = PGROUNDUP(newsz); a < PGROUNDUP(oldsz); a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0)
+      panic("uvmshrink: walk");
+    if((*pte & PTE_V) == 0)
+      panic("uvmshrink: not mapped");
+    batch[n++] = PTE2PA(*pte);
+    *pte = 0;
+    if(n == NBATCH || a + PGSIZE >= PGROUNDUP(oldsz)){
+      tlbshootdown(pagetable);
+      for(i = 0; i < n; i++)
+        kfree((void*)batch[i]);
+      n = 0;
+    }
+  }
+  return newsz;
+}
+
 // Recursively free page-table pages.
 // All leaf mappings must already have been removed.
 void
@@ -19,6 +19,7 @@ main(void)
   if(open("console", O_RDWR) < 0){
     mknod("console", CONSOLE, 0);
     mknod("statistics", STATS, 0);
+    mknod("schedstats", SCHEDSTATS, 0);
     open("console", O_RDWR);
   }
   dup(0);  // stdout
@@ -0,0 +1,50 @@
+// Time round trips of a byte between two processes over
+// a pair of pipes, mostly context switches.
+// usage: pingpong [round trips]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  int p1[2], p2[2];   // parent -> child, child -> parent
+  int i, n, pid;
+  uint64 t0, t1;
+  char buf = 'x';
+
+  n = argc > 1 ? atoi(argv[1]) : 10000;
+  if(pipe(p1) < 0 || pipe(p2) < 0){
+    printf("pingpong: pipe failed\n");
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("pingpong: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(p1[1]);
+    close(p2[0]);
+    while(read(p1[0], &buf, 1) == 1)
+      write(p2[1], &buf, 1);
+    exit(0);
+  }
+
+  close(p1[0]);
+  close(p2[1]);
+  t0 = now();
+  for(i = 0; i < n; i++){
+    if(write(p1[1], &buf, 1) != 1 || read(p2[0], &buf, 1) != 1){
+      printf("pingpong: lost the ball\n");
+      exit(1);
+    }
+  }
+  t1 = now();
+  close(p1[1]);
+  wait(0);
+  printf("pingpong: %d round trips in %luus, %luns each\n",
+         n, (t1 - t0) / 1000, n > 0 ? (t1 - t0) / n : 0);
+  exit(0);
+}
@@ -0,0 +1,43 @@
+// Run a command and report the real, user and system
+// time it took.
+// usage: time command [args...]
+
+#include "kernel/types.h"
+#include "kernel/rusage.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct rusage ru;
+  uint64 t0;
+  int pid, xstatus;
+
+  if(argc < 2){
+    fprintf(2, "usage: time command [args...]\n");
+    exit(1);
+  }
+
+  t0 = now();
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "time: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "time: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(&xstatus);
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0){
+    fprintf(2, "time: getrusage failed\n");
+    exit(1);
+  }
+  printf("real %lums user %lums sys %lums\n",
+         (now() - t0) / 1000000,
+         ru.utime / 1000000, ru.stime / 1000000);
+  printf("%lu voluntary and %lu involuntary switches, %lu faults\n",
+         ru.nvcsw, ru.nivcsw, ru.nfault);
+  exit(xstatus);
+}
@@ -1,6 +1,7 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/time.h"
 #include "user/user.h"
 
 //
@@ -106,6 +107,24 @@ atoi(const char *s)
   return n;
 }
 
+// make the caller's scheduling priority worse by incr
+// (better if negative); see setpriority().
+int
+nice(int incr)
+{
+  return setpriority(0, getpriority(0) + incr);
+}
+
+// nanoseconds since boot.
+uint64
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 void*
 memmove(void *vdst, const void *vsrc, int n)
 {
@@ -3,6 +3,8 @@ typedef unsigned long size_t;
 typedef long int off_t;
 #endif
 struct stat;
+struct rusage;
+struct timespec;
 
 // system calls
 int fork(void);
@@ -26,6 +28,18 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int setpriority(int, int);
+int getpriority(int);
+int nsleep(uint64);
+int waitpid(int, int*, int);
+int setaffinity(int, int);
+int getaffinity(int);
+int clone(void(*)(void*), void*, void*);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
+int getrusage(int, struct rusage*);
+int setscheduler(int, int);
+int clock_gettime(int, struct timespec*);
 #ifdef LAB_NET
 int bind(uint16);
 int unbind(uint16);
@@ -50,6 +64,8 @@ char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 int atoi(const char*);
+int nice(int);
+uint64 now(void);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 #ifdef LAB_LOCK
@@ -59,3 +75,18 @@ int statistics(void*, int);
 // umalloc.c
 void* malloc(uint);
 void free(void*);
+
+// usync.c
+struct mutex {
+  int v;
+};
+struct cond {
+  int seq;
+};
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
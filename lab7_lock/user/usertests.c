@@ -4,6 +4,8 @@
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/rusage.h"
+#include "kernel/time.h"
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
@@ -874,6 +876,544 @@ preempt(char *s)
   wait(0);
 }
 
+// setpriority(), getpriority() and nice() agree, clamp out
+// of range priorities, and are inherited by fork().
+void
+priority(char *s)
+{
+  int pid, xstatus;
+
+  if(getpriority(0) != 0){
+    printf("%s: default priority %d\n", s, getpriority(0));
+    exit(1);
+  }
+  if(setpriority(0, 1) != 0 || getpriority(getpid()) != 1){
+    printf("%s: setpriority failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(getpriority(0) == 1 ? 0 : 1);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child did not inherit priority\n", s);
+    exit(1);
+  }
+  if(nice(1000) != 0 || getpriority(0) <= 1 || nice(-1000) != 0 ||
+     getpriority(0) != 0){
+    printf("%s: priority not clamped\n", s);
+    exit(1);
+  }
+  if(setpriority(1000000, 0) != -1 || getpriority(1000000) != -1){
+    printf("%s: no such pid, but succeeded\n", s);
+    exit(1);
+  }
+}
+
+// nsleep() wakes at its deadline, not at the next clock
+// tick, and sleep() still waits whole ticks.
+void
+nsleeptest(char *s)
+{
+  int i, t0, t1;
+
+  t0 = uptime();
+  for(i = 0; i < 20; i++){
+    if(nsleep(1000000) != 0){
+      printf("%s: nsleep failed\n", s);
+      exit(1);
+    }
+  }
+  t1 = uptime();
+  if(t1 - t0 > 5){
+    printf("%s: 20 1ms nsleeps took %d ticks\n", s, t1 - t0);
+    exit(1);
+  }
+  t0 = uptime();
+  sleep(2);
+  if(uptime() - t0 < 1){
+    printf("%s: sleep(2) returned early\n", s);
+    exit(1);
+  }
+
+  // a deadline too far off to represent sleeps until killed,
+  // rather than wrapping into the past.
+  int pid = fork(), xstatus;
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    nsleep(~0UL);
+    exit(0);
+  }
+  sleep(2);
+  kill(pid);
+  if(wait(&xstatus) != pid || xstatus == 0){
+    printf("%s: nsleep(~0) returned at once\n", s);
+    exit(1);
+  }
+}
+
+// more processes at once than the old fixed-size table held,
+// each found by kill() through the pid hash.
+void
+manyprocs(char *s)
+{
+  enum { N = 200 };
+  int pids[N];
+  int i, n, xstatus;
+
+  for(n = 0; n < N; n++){
+    pids[n] = fork();
+    if(pids[n] < 0)
+      break;
+    if(pids[n] == 0){
+      for(;;)
+        sleep(1000);
+    }
+  }
+  if(n < 100){
+    printf("%s: only %d processes\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(kill(pids[i]) != 0){
+      printf("%s: kill %d failed\n", s, pids[i]);
+      exit(1);
+    }
+  }
+  for(i = 0; i < n; i++){
+    if(wait(&xstatus) < 0){
+      printf("%s: wait failed\n", s);
+      exit(1);
+    }
+  }
+  if(kill(pids[0]) != -1){
+    printf("%s: killed a reaped process\n", s);
+    exit(1);
+  }
+}
+
+// waitpid() waits for the given child only, and WNOHANG
+// returns 0 while that child is still running.
+void
+waitpidtest(char *s)
+{
+  int fds[2], a, b, xstatus;
+  char c;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  a = fork();
+  if(a == 0)
+    exit(3);
+  b = fork();
+  if(a < 0 || b < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(b == 0){
+    close(fds[1]);
+    read(fds[0], &c, 1);
+    exit(4);
+  }
+  close(fds[0]);
+  if(waitpid(b, &xstatus, WNOHANG) != 0){
+    printf("%s: WNOHANG didn't return 0\n", s);
+    exit(1);
+  }
+  if(waitpid(a, &xstatus, 0) != a || xstatus != 3){
+    printf("%s: waitpid(a) failed\n", s);
+    exit(1);
+  }
+  if(waitpid(a, 0, 0) != -1 || waitpid(getpid(), 0, WNOHANG) != -1){
+    printf("%s: waited for a non-child\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  if(waitpid(-1, &xstatus, 0) != b || xstatus != 4){
+    printf("%s: waitpid(-1) failed\n", s);
+    exit(1);
+  }
+  if(waitpid(-1, 0, WNOHANG) != -1){
+    printf("%s: no children, but WNOHANG returned 0\n", s);
+    exit(1);
+  }
+}
+
+// setaffinity() and getaffinity() agree, refuse an empty
+// mask, and are inherited by fork().
+void
+affinity(char *s)
+{
+  int pid, xstatus, all;
+
+  all = getaffinity(0);
+  if(all <= 0 || (all & 1) == 0){
+    printf("%s: default affinity %x\n", s, all);
+    exit(1);
+  }
+  if(setaffinity(0, 0) != -1 || getaffinity(0) != all){
+    printf("%s: empty mask accepted\n", s);
+    exit(1);
+  }
+  if(setaffinity(0, 1) != 0 || getaffinity(getpid()) != 1){
+    printf("%s: setaffinity failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(getaffinity(0) == 1 ? 0 : 1);
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child did not inherit affinity\n", s);
+    exit(1);
+  }
+  if(setaffinity(0, all) != 0 || getaffinity(0) != all){
+    printf("%s: could not restore affinity\n", s);
+    exit(1);
+  }
+  if(setaffinity(1000000, 1) != -1 || getaffinity(1000000) != -1){
+    printf("%s: no such pid, but succeeded\n", s);
+    exit(1);
+  }
+}
+
+volatile int clonecount;
+char * volatile clonemem;
+int clonefds[2];
+int clonefd = -1;
+
+void
+clonethread(void *arg)
+{
+  char c;
+  int i;
+
+  for(i = 0; i < 1000; i++)
+    __sync_fetch_and_add(&clonecount, 1);
+  if(arg == 0){
+    clonemem = sbrk(PGSIZE);
+    clonemem[0] = 'x';
+    // hold the address space until the parent has tried exec.
+    read(clonefds[0], &c, 1);
+  } else {
+    // the descriptor and directory outlive this thread.
+    if(mkdir("clonedir") < 0 || chdir("clonedir") < 0 ||
+       (clonefd = open("clonefile", O_CREATE|O_RDWR)) < 0)
+      exit(1);
+  }
+  exit(0);
+}
+
+// threads made by clone() share memory with the caller: they
+// add to one counter and see each other's sbrk(), and exec()
+// is refused while they run. They also share open files and
+// the current directory.
+void
+clonetest(char *s)
+{
+  char *stack;
+  char *args[] = { "echo", "clonetest", 0 };
+  int i, fd, xstatus;
+
+  if(pipe(clonefds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 2; i++){
+    stack = malloc(PGSIZE);
+    if(clone(clonethread, stack + PGSIZE, (void*)(uint64)i) < 0){
+      printf("%s: clone failed\n", s);
+      exit(1);
+    }
+  }
+  while(clonemem == 0)
+    ;
+  if(clonemem[0] != 'x'){
+    printf("%s: thread's sbrk not seen\n", s);
+    exit(1);
+  }
+  if(exec("echo", args) != -1){
+    printf("%s: exec while threaded succeeded\n", s);
+    exit(1);
+  }
+  write(clonefds[1], "x", 1);
+  for(i = 0; i < 2; i++){
+    if(wait(&xstatus) < 0 || xstatus != 0){
+      printf("%s: thread failed\n", s);
+      exit(1);
+    }
+  }
+  if(clonecount != 2000){
+    printf("%s: count %d, not 2000\n", s, clonecount);
+    exit(1);
+  }
+  close(clonefds[0]);
+  close(clonefds[1]);
+
+  if(write(clonefd, "x", 1) != 1 || close(clonefd) != 0){
+    printf("%s: thread's descriptor not shared\n", s);
+    exit(1);
+  }
+  if((fd = open("../clonedir/clonefile", O_RDONLY)) < 0 || open("clonedir", O_RDONLY) >= 0){
+    printf("%s: thread's chdir not shared\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("clonefile");
+  chdir("..");
+  unlink("clonedir");
+}
+
+struct mutex futexmu;
+struct cond futexcv;
+int futexcount;
+int futexdone;
+
+void
+futexthread(void *arg)
+{
+  int i;
+
+  for(i = 0; i < 10000; i++){
+    mutex_lock(&futexmu);
+    futexcount++;
+    mutex_unlock(&futexmu);
+  }
+  mutex_lock(&futexmu);
+  futexdone++;
+  cond_broadcast(&futexcv);
+  mutex_unlock(&futexmu);
+  exit(0);
+}
+
+// mutexes and condition variables built on futexes keep
+// threads' updates of shared memory apart.
+void
+futextest(char *s)
+{
+  int i, xstatus, v = 0;
+
+  if(futex_wait(&v, 1) != -1){
+    printf("%s: futex_wait slept on a changed word\n", s);
+    exit(1);
+  }
+  if(futex_wake(&v, 1) != 0){
+    printf("%s: futex_wake woke a thread from nowhere\n", s);
+    exit(1);
+  }
+  mutex_init(&futexmu);
+  cond_init(&futexcv);
+  for(i = 0; i < 2; i++){
+    if(clone(futexthread, (char*)malloc(PGSIZE) + PGSIZE, 0) < 0){
+      printf("%s: clone failed\n", s);
+      exit(1);
+    }
+  }
+  mutex_lock(&futexmu);
+  while(futexdone < 2)
+    cond_wait(&futexcv, &futexmu);
+  if(futexcount != 20000){
+    printf("%s: count %d, not 20000\n", s, futexcount);
+    exit(1);
+  }
+  mutex_unlock(&futexmu);
+  for(i = 0; i < 2; i++){
+    if(wait(&xstatus) < 0 || xstatus != 0){
+      printf("%s: thread failed\n", s);
+      exit(1);
+    }
+  }
+}
+
+char * volatile shootpage;
+volatile int shootgo;
+
+void
+shootthread(void *arg)
+{
+  shootgo = 1;
+  for(;;)
+    shootpage[0]++;
+}
+
+// a thread still writing memory that another thread frees
+// with sbrk() faults, rather than writing the freed page
+// through a stale TLB entry on its hart.
+void
+shootdown(char *s)
+{
+  char *stack;
+  int xstatus;
+
+  stack = malloc(PGSIZE);
+  shootpage = sbrk(PGSIZE);
+  if(shootpage == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  if(clone(shootthread, stack + PGSIZE, 0) < 0){
+    printf("%s: clone failed\n", s);
+    exit(1);
+  }
+  while(shootgo == 0)
+    ;
+  sleep(1);
+  sbrk(-PGSIZE);
+  if(wait(&xstatus) < 0 || xstatus != -1){
+    printf("%s: thread survived freeing its page\n", s);
+    exit(1);
+  }
+}
+
+// getrusage() sees user time spent spinning, by the caller
+// and by a child once it has been waited for.
+void
+rusagetest(char *s)
+{
+  struct rusage ru;
+  int pid, t0, xstatus;
+
+  t0 = uptime();
+  while(uptime() < t0 + 2)
+    ;
+  if(getrusage(RUSAGE_SELF, &ru) < 0 || ru.utime == 0 || ru.stime == 0){
+    printf("%s: no user or system time\n", s);
+    exit(1);
+  }
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0 || ru.utime != 0){
+    printf("%s: time for children not yet waited for\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    t0 = uptime();
+    while(uptime() < t0 + 2)
+      ;
+    exit(0);
+  }
+  wait(&xstatus);
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0 || ru.utime == 0 || ru.nvcsw == 0){
+    printf("%s: no time or switches for child\n", s);
+    exit(1);
+  }
+  if(getrusage(5, &ru) != -1){
+    printf("%s: bad who accepted\n", s);
+    exit(1);
+  }
+}
+
+// the schedstats device reports latency histograms for
+// the CPU that ran this test.
+void
+schedstatstest(char *s)
+{
+  char buf[512];
+  int fd, n;
+
+  if((fd = open("schedstats", O_RDONLY)) < 0){
+    printf("%s: open schedstats failed\n", s);
+    exit(1);
+  }
+  n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if(n <= 0){
+    printf("%s: read schedstats failed\n", s);
+    exit(1);
+  }
+  buf[n] = 0;
+  if(memcmp(buf, "--- scheduler latency", 21) != 0 || strchr(buf, '\n') == 0){
+    printf("%s: bad schedstats: %s\n", s, buf);
+    exit(1);
+  }
+}
+
+// setscheduler() switches policies, and a SCHED_FIFO process
+// spinning on this CPU still leaves it some time, thanks to
+// the throttle.
+void
+rtfifo(char *s)
+{
+  int pid, xstatus;
+
+  if(setscheduler(0, 7) != -1 || setscheduler(1000000, SCHED_FIFO) != -1){
+    printf("%s: bad setscheduler accepted\n", s);
+    exit(1);
+  }
+  if(setscheduler(0, SCHED_FIFO) != SCHED_OTHER ||
+     setscheduler(0, SCHED_OTHER) != SCHED_FIFO){
+    printf("%s: setscheduler failed\n", s);
+    exit(1);
+  }
+  if(setaffinity(0, 1) != 0){
+    printf("%s: setaffinity failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    setscheduler(0, SCHED_FIFO);
+    for(;;)
+      ;
+  }
+  sleep(1);
+  kill(pid);
+  if(wait(&xstatus) != pid){
+    printf("%s: wait failed\n", s);
+    exit(1);
+  }
+}
+
+// CLOCK_MONOTONIC has better than tick resolution, and
+// measures a sleep() of one tick as at least 1/HZ seconds.
+void
+clocktest(char *s)
+{
+  struct timespec t0, t1;
+  uint64 ns;
+
+  if(clock_gettime(5, &t0) != -1){
+    printf("%s: bad clock accepted\n", s);
+    exit(1);
+  }
+  if(clock_gettime(CLOCK_MONOTONIC, &t0) < 0 ||
+     clock_gettime(CLOCK_MONOTONIC, &t1) < 0){
+    printf("%s: clock_gettime failed\n", s);
+    exit(1);
+  }
+  if(t0.tv_nsec >= 1000000000 || t1.tv_sec < t0.tv_sec ||
+     (t1.tv_sec == t0.tv_sec && t1.tv_nsec < t0.tv_nsec)){
+    printf("%s: clock went backwards\n", s);
+    exit(1);
+  }
+  sleep(1);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns = (t1.tv_sec - t0.tv_sec) * 1000000000 + t1.tv_nsec - t0.tv_nsec;
+  if(ns < 1000000000 / HZ){
+    printf("%s: sleep(1) took %lums\n", s, ns / 1000000);
+    exit(1);
+  }
+}
+
 // try to find any races between exit and wait
 void
 exitwait(char *s)
@@ -2611,6 +3151,18 @@ struct test {
   {pipe1, "pipe1"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
+  {priority, "priority"},
+  {nsleeptest, "nsleeptest"},
+  {manyprocs, "manyprocs"},
+  {waitpidtest, "waitpidtest"},
+  {affinity, "affinity"},
+  {clonetest, "clonetest"},
+  {futextest, "futextest"},
+  {shootdown, "shootdown"},
+  {rusagetest, "rusagetest"},
+  {schedstatstest, "schedstatstest"},
+  {rtfifo, "rtfifo"},
+  {clocktest, "clocktest"},
   {exitwait, "exitwait"},
   {reparent, "reparent" },
   {twochildren, "twochildren"},
@@ -0,0 +1,75 @@
+// Mutexes and condition variables for threads made by clone().
+//
+// Both are built on futex_wait() and futex_wake(), so a thread
+// enters the kernel only to sleep on a lock that is held, or
+// to wake threads that are sleeping.
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+// m->v is 0 if m is free, 1 if held, and 2 if held and some
+// thread may be sleeping on it.
+void
+mutex_init(struct mutex *m)
+{
+  m->v = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->v, 0, 1)) == 0)
+    return;
+  // mark it contended, so the holder wakes us.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->v, 2);
+  while(c != 0){
+    futex_wait(&m->v, 2);
+    c = __sync_lock_test_and_set(&m->v, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->v, 1) != 1){
+    __sync_lock_release(&m->v);
+    futex_wake(&m->v, 1);
+  }
+}
+
+// c->seq counts signals, so that a waiter can tell
+// whether it missed one between unlocking and sleeping.
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+// Release m and sleep until signalled, then re-acquire m.
+// May return without a signal; callers recheck in a loop.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 0x7fffffff);
+}
@@ -36,3 +36,15 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("setpriority");
+entry("getpriority");
+entry("nsleep");
+entry("waitpid");
+entry("setaffinity");
+entry("getaffinity");
+entry("clone");
+entry("futex_wait");
+entry("futex_wake");
+entry("getrusage");
+entry("setscheduler");
+entry("clock_gettime");
@@ -21,6 +21,7 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "fcntl.h"
 
 #define BACKSPACE 0x100
 #define C(x)  ((x)-'@')  // Control-x
@@ -84,6 +85,9 @@ consoleread(int user_dst, uint64 dst, int n)
   char cbuf;
 
   target = n;
+  // either_copyout() below can't fault pages in under cons.lock.
+  if(user_dst)
+    vmaprefault(myproc(), dst, n, PROT_WRITE);
   acquire(&cons.lock);
   while(n > 0){
     // wait until interrupt handler has put some
@@ -109,8 +113,11 @@ consoleread(int user_dst, uint64 dst, int n)
 
     // copy the input byte to the user-space buffer.
     cbuf = c;
-    if(either_copyout(user_dst, dst, &cbuf, 1) == -1)
+    if(either_copyout(user_dst, dst, &cbuf, 1) == -1){
+      // leave the byte for the next read.
+      cons.r--;
       break;
+    }
 
     dst++;
     --n;
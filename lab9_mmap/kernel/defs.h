@@ -12,6 +12,7 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vma;
 
 // bio.c
 void            binit(void);
@@ -57,6 +58,7 @@ int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
+void            itext(struct inode*, int);
 
 // ramdisk.c
 void            ramdiskinit(void);
@@ -67,6 +69,7 @@ void            ramdiskrw(struct buf*);
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
+void            kdup(void *);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -92,7 +95,7 @@ int             fork(void);
 int             growproc(int);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
-void            proc_freepagetable(pagetable_t, uint64);
+void            proc_freepagetable(pagetable_t, uint64, uint64);
 int             kill(int);
 int             killed(struct proc*);
 void            setkilled(struct proc*);
@@ -172,7 +175,7 @@ pagetable_t     uvmcreate(void);
 void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
-int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmcopy(pagetable_t, pagetable_t, uint64, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -188,6 +191,26 @@ void            vmprint(pagetable_t);
 pte_t*          pgpte(pagetable_t, uint64);
 #endif
 
+// textcache.c
+void            textinit(void);
+char*           textget(struct inode*, uint64, uint);
+void            textinval(struct inode*);
+
+// vma.c
+struct vma*     vmalookup(struct proc*, uint64);
+int             vmaoverlap(struct proc*, uint64, uint64);
+uint64          vmacreate(struct proc*, uint64, int, int, struct inode*, uint64);
+void            vmasegment(struct proc*, uint64, uint64, int, struct inode*, uint64, uint64);
+int             vmafault(struct proc*, uint64, int);
+void            vmaprefault(struct proc*, uint64, uint64, int);
+int             vmaunmap(struct proc*, uint64, uint64);
+int             vmaadvise(struct proc*, uint64, uint64, int);
+int             vmasync(struct proc*, uint64, uint64, int);
+int             vmacopy(struct proc*, struct proc*);
+void            vmafree(struct proc*);
+int             vmareserve(struct proc*, int);
+void            vmatabfree(struct proc*);
+
 // plic.c
 void            plicinit(void);
 void            plicinithart(void);
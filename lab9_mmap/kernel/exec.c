@@ -5,18 +5,20 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
 #include "elf.h"
+#include "fcntl.h"
 
-static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
-
-int flags2perm(int flags)
+int flags2prot(int flags)
 {
-    int perm = 0;
+    int prot = PROT_READ;
     if(flags & 0x1)
-      perm = PTE_X;
+      prot |= PROT_EXEC;
     if(flags & 0x2)
-      perm |= PTE_W;
-    return perm;
+      prot |= PROT_WRITE;
+    return prot;
 }
 
 int
@@ -24,10 +26,12 @@ exec(char *path, char **argv)
 {
   char *s, *last;
   int i, off;
-  uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
+  uint64 argc, sz = 0, segtop = 0, sp, ustack[MAXARG], stackbase;
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *text = 0;
   struct proghdr ph;
+  struct vma seg[MAXSEG];
+  int nseg = 0;
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
@@ -46,10 +50,17 @@ exec(char *path, char **argv)
   if(elf.magic != ELF_MAGIC)
     goto bad;
 
+  // refuse writes to ip from now until the program's
+  // segments are gone; see itext().
+  text = idup(ip);
+  itext(text, 1);
+
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record the program's segments. Nothing is read yet:
+  // vmafault() reads each page in from ip when the
+  // program first touches it, and zero-fills the bss.
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -61,24 +72,34 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
+    if(ph.vaddr < PGROUNDUP(segtop) || ph.vaddr + ph.memsz >= MMAPTOP)
       goto bad;
-    sz = sz1;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(ph.off + ph.filesz < ph.off || ph.off + ph.filesz > ip->size)
+      goto bad;
+    if(ph.memsz == 0)
+      continue;
+    if(nseg == MAXSEG)
       goto bad;
+    seg[nseg].addr = ph.vaddr;
+    seg[nseg].len = ph.memsz;
+    seg[nseg].prot = flags2prot(ph.flags);
+    seg[nseg].off = ph.off;
+    seg[nseg].filesz = ph.filesz;
+    nseg++;
+    segtop = ph.vaddr + ph.memsz;
   }
+  // the segments will each hold a reference to ip.
   iunlockput(ip);
   end_op();
   ip = 0;
 
   p = myproc();
-  uint64 oldsz = p->sz;
+  uint64 oldsz = p->sz, oldsegtop = p->segtop;
 
   // Allocate some pages at the next page boundary.
   // Make the first inaccessible as a stack guard.
   // Use the rest as the user stack.
-  sz = PGROUNDUP(sz);
+  sz = segtop = PGROUNDUP(segtop);
   uint64 sz1;
   if((sz1 = uvmalloc(pagetable, sz, sz + (USERSTACK+1)*PGSIZE, PTE_W)) == 0)
     goto bad;
@@ -119,48 +140,42 @@ exec(char *path, char **argv)
     if(*s == '/')
       last = s+1;
   safestrcpy(p->name, last, sizeof(p->name));
+
+  // the old image's regions go first, so this is room enough.
+  if(vmareserve(p, nseg) < 0)
+    goto bad;
     
   // Commit to the user image.
+  vmafree(p);
+  for(i = 0; i < nseg; i++)
+    vmasegment(p, seg[i].addr, seg[i].len, seg[i].prot, text,
+               seg[i].off, seg[i].filesz);
+  itext(text, -1);
+  begin_op();
+  iput(text);
+  end_op();
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
+  p->segtop = segtop;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  proc_freepagetable(oldpagetable, oldsegtop, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
  bad:
   if(pagetable)
-    proc_freepagetable(pagetable, sz);
+    proc_freepagetable(pagetable, segtop, sz);
   if(ip){
     iunlockput(ip);
     end_op();
   }
-  return -1;
-}
-
-// Load a program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
-// Returns 0 on success, -1 on failure.
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
-{
-  uint i, n;
-  uint64 pa;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
-      return -1;
+  if(text){
+    itext(text, -1);
+    begin_op();
+    iput(text);
+    end_op();
   }
-  
-  return 0;
+  return -1;
 }
@@ -287,6 +287,18 @@ idup(struct inode *ip)
   return ip;
 }
 
+// Count n more program segments mapping ip, or -n fewer.
+// Each holds a reference to ip as well. writei() refuses to
+// change ip while any do, so that the pages a running
+// program has yet to fault in match those it has.
+void
+itext(struct inode *ip, int n)
+{
+  acquire(&itable.lock);
+  ip->ntext += n;
+  release(&itable.lock);
+}
+
 // Lock the given inode.
 // Reads the inode from disk if necessary.
 void
@@ -429,6 +441,7 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  textinval(ip);
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -512,7 +525,13 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
+  // ntext only rises from 0 in exec(), which holds ip->lock,
+  // so no lock is needed to see it.
+  if(ip->ntext > 0)
+    return -1;
 
+  if(n > 0)
+    textinval(ip);
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
     uint addr = bmap(ip, off/BSIZE);
     if(addr == 0)
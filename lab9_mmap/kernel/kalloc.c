@@ -23,10 +23,22 @@ struct {
   struct run *freelist;
 } kmem;
 
+// References to each page of physical memory, for pages
+// mapped in more than one place, such as program text
+// shared through textcache.c. kfree() only frees a page
+// when the last reference goes.
+struct {
+  struct spinlock lock;
+  int count[(PHYSTOP - KERNBASE) / PGSIZE];
+} kref;
+
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  initlock(&kref.lock, "kref");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -39,10 +51,11 @@ freerange(void *pa_start, void *pa_end)
     kfree(p);
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// Drop a reference to the page of physical memory pointed
+// at by pa, which normally should have been returned by a
+// call to kalloc(), and free it if that was the last.
+// (The exception is when initializing the allocator;
+// see kinit above.)
 void
 kfree(void *pa)
 {
@@ -51,6 +64,15 @@ kfree(void *pa)
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  acquire(&kref.lock);
+  if(kref.count[PA2REF(pa)] > 1){
+    kref.count[PA2REF(pa)]--;
+    release(&kref.lock);
+    return;
+  }
+  kref.count[PA2REF(pa)] = 0;
+  release(&kref.lock);
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
@@ -76,7 +98,25 @@ kalloc(void)
     kmem.freelist = r->next;
   release(&kmem.lock);
 
-  if(r)
+  if(r){
     memset((char*)r, 5, PGSIZE); // fill with junk
+    acquire(&kref.lock);
+    kref.count[PA2REF(r)] = 1;
+    release(&kref.lock);
+  }
   return (void*)r;
 }
+
+// Take another reference to the allocated page pa.
+void
+kdup(void *pa)
+{
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kdup");
+
+  acquire(&kref.lock);
+  if(kref.count[PA2REF(pa)] < 1)
+    panic("kdup: free page");
+  kref.count[PA2REF(pa)]++;
+  release(&kref.lock);
+}
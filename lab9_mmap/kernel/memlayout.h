@@ -54,6 +54,8 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   mmap()ed regions, allocated downward from MMAPTOP
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define MMAPTOP TRAPFRAME
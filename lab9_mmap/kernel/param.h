@@ -6,10 +6,15 @@
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
+#define MAXSEG       8   // max loadable segments in an exec()ed program
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define NTEXT        64    // pages in the shared program text cache
+#define NVMA         256   // mapped regions per process
+#define FAULTAROUND  4     // pages filled per fault on a mapped file
+#define READAHEAD    16    // pages filled per fault under MADV_SEQUENTIAL
 
@@ -7,6 +7,7 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "fcntl.h"
 
 #define PIPESIZE 512
 
@@ -79,6 +80,9 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
   int i = 0;
   struct proc *pr = myproc();
 
+  // copyin() below can't fault pages in under pi->lock.
+  vmaprefault(pr, addr, n, PROT_READ);
+
   acquire(&pi->lock);
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
@@ -109,6 +113,9 @@ piperead(struct pipe *pi, uint64 addr, int n)
   struct proc *pr = myproc();
   char ch;
 
+  // copyout() below can't fault pages in under pi->lock.
+  vmaprefault(pr, addr, n < PIPESIZE ? n : PIPESIZE, PROT_WRITE);
+
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
     if(killed(pr)){
@@ -120,9 +127,10 @@ piperead(struct pipe *pi, uint64 addr, int n)
   for(i = 0; i < n; i++){  //DOC: piperead-copy
     if(pi->nread == pi->nwrite)
       break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
+    ch = pi->data[pi->nread % PIPESIZE];
     if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
       break;
+    pi->nread++;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "fcntl.h"
 
 struct cpu cpus[NCPU];
 
@@ -159,9 +160,11 @@ freeproc(struct proc *p)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
   if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+    proc_freepagetable(p->pagetable, p->segtop, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  p->segtop = 0;
+  vmatabfree(p);
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -206,13 +209,16 @@ proc_pagetable(struct proc *p)
 }
 
 // Free a process's page table, and free the
-// physical memory it refers to.
+// physical memory it refers to from segtop to sz.
+// Pages below segtop belong to exec()'s segments,
+// which vmafree() has already torn down.
 void
-proc_freepagetable(pagetable_t pagetable, uint64 sz)
+proc_freepagetable(pagetable_t pagetable, uint64 segtop, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
-  uvmfree(pagetable, sz);
+  uvmdealloc(pagetable, sz, segtop);
+  uvmfree(pagetable, 0);
 }
 
 // a user program that calls exec("/init")
@@ -264,11 +270,23 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
+    if(vmaoverlap(p, sz, PGROUNDUP(sz + n)))
+      return -1;
     if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    if(sz + n < p->segtop){
+      // give back the top of exec()'s program segments too.
+      if(vmaoverlap(p, PGROUNDUP(sz + n), p->segtop) &&
+         vmaunmap(p, PGROUNDUP(sz + n), p->segtop - PGROUNDUP(sz + n)) < 0)
+        return -1;
+      uvmdealloc(p->pagetable, sz, p->segtop);
+      p->segtop = PGROUNDUP(sz + n);
+      sz = sz + n;
+    } else {
+      sz = uvmdealloc(p->pagetable, sz, sz + n);
+    }
   }
   p->sz = sz;
   return 0;
@@ -289,12 +307,20 @@ fork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  if(uvmcopy(p->pagetable, np->pagetable, p->segtop, p->sz) < 0){
     freeproc(np);
     release(&np->lock);
     return -1;
   }
   np->sz = p->sz;
+  np->segtop = p->segtop;
+
+  // Copy mmap()ed regions.
+  if(vmacopy(p, np) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -351,6 +377,9 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // Write back and unmap mmap()ed regions.
+  vmafree(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -394,6 +423,10 @@ wait(uint64 addr)
   int havekids, pid;
   struct proc *p = myproc();
 
+  // the copyout() below can't fault pages in under the locks.
+  if(addr != 0)
+    vmaprefault(p, addr, sizeof(pp->xstate), PROT_WRITE);
+
   acquire(&wait_lock);
 
   for(;;){
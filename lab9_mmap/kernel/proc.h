@@ -79,6 +79,24 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// A region of user memory set up by mmap(), or a program
+// segment set up by exec(). Pages are filled in from the
+// backing inode by vmafault() on first touch; see vma.c.
+struct vma {
+  uint64 addr;                 // start, page-aligned
+  uint64 len;                  // length in bytes, a multiple of PGSIZE
+  int prot;                    // PROT_READ | PROT_WRITE | PROT_EXEC
+  int flags;                   // MAP_SHARED or MAP_PRIVATE
+  int advice;                  // last madvise() hint, MADV_NORMAL by default
+  struct inode *ip;            // backing file
+  uint64 off;                  // file offset that addr maps
+  uint64 filesz;               // bytes from off backed by ip; the rest is zero
+  int text;                    // a program segment, counted in ip->ntext
+};
+
+// Pages a process's table of regions may take.
+#define NVMAPAGE ((NVMA * sizeof(struct vma) + PGSIZE - 1) / PGSIZE)
+
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -98,10 +116,14 @@ struct proc {
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
+  uint64 segtop;               // exec()'s segments lie below, the stack and heap above
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct vma *vma[NVMAPAGE];   // pages of mmap()ed regions, sorted by addr; see vma.c
+  int nvma;                    // number of regions in them
+  int vmahint;                 // index of the region vmalookup() last found
 };
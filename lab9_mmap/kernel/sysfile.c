@@ -341,6 +341,13 @@ sys_open(void)
     return -1;
   }
 
+  // a running program's text can't be truncated.
+  if((omode & O_TRUNC) && ip->ntext > 0){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+
   if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
     if(f)
       fileclose(f);
@@ -503,3 +510,64 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+// addr is only a hint, and xv6 ignores it.
+uint64
+sys_mmap(void)
+{
+  uint64 len, off;
+  int prot, flags;
+  struct file *f;
+
+  argaddr(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argaddr(5, &off);
+  if(argfd(4, 0, &f) < 0)
+    return -1;
+  if(f->type != FD_INODE || off % PGSIZE != 0)
+    return -1;
+  if(flags != MAP_SHARED && flags != MAP_PRIVATE)
+    return -1;
+  if((prot & PROT_READ) && !f->readable)
+    return -1;
+  // a private mapping's writes never reach the file.
+  if((prot & PROT_WRITE) && flags == MAP_SHARED && !f->writable)
+    return -1;
+  return vmacreate(myproc(), len, prot, flags, f->ip, off);
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr, len;
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  return vmaunmap(myproc(), addr, len);
+}
+
+uint64
+sys_madvise(void)
+{
+  uint64 addr, len;
+  int advice;
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  argint(2, &advice);
+  return vmaadvise(myproc(), addr, len, advice);
+}
+
+uint64
+sys_msync(void)
+{
+  uint64 addr, len;
+  int flags;
+
+  argaddr(0, &addr);
+  argaddr(1, &len);
+  argint(2, &flags);
+  return vmasync(myproc(), addr, len, flags);
+}
@@ -0,0 +1,142 @@
+// Shared program text.
+//
+// Read-only private mappings, chiefly the text of exec()ed
+// programs, never change their pages, so every process mapping
+// the same bytes of a file can share one copy. The cache holds
+// a reference (see kdup() in kalloc.c) to each page it knows
+// about, and each mapping holds another.
+//
+// Interface:
+// * vmapage() calls textget() to find or read in a page.
+// * writei() and itrunc() call textinval() when a file changes;
+//     processes already running keep the pages they have.
+//
+// Entries are hashed by (dev, inum), so that textinval() only
+// looks at one bucket. ip->lock serializes fills and
+// invalidations of one file; tcache.lock protects the table.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+
+#define NBUCKET 13
+
+struct textpage {
+  uint dev;
+  uint inum;
+  uint64 off;               // file offset of the page's first byte
+  uint n;                   // bytes from the file; the rest is zero
+  char *pa;                 // 0 if the entry is free
+  struct textpage *next;    // hash chain
+};
+
+struct {
+  struct spinlock lock;
+  struct textpage page[NTEXT];
+  struct textpage *bucket[NBUCKET];
+  int hand;                 // next entry to evict when full
+} tcache;
+
+void
+textinit(void)
+{
+  initlock(&tcache.lock, "tcache");
+}
+
+static struct textpage**
+bucket(uint dev, uint inum)
+{
+  return &tcache.bucket[(dev * 31 + inum) % NBUCKET];
+}
+
+// Take t out of its hash chain and drop the cache's
+// reference to its page. Caller holds tcache.lock.
+static void
+textdrop(struct textpage *t)
+{
+  struct textpage **pp;
+
+  for(pp = bucket(t->dev, t->inum); *pp; pp = &(*pp)->next){
+    if(*pp == t){
+      *pp = t->next;
+      break;
+    }
+  }
+  kfree(t->pa);
+  t->pa = 0;
+}
+
+// Return a page holding n bytes of ip from offset off,
+// then zeros, shared with every other caller that asked for
+// the same bytes. The caller owns a reference to the page,
+// to be dropped with kfree(). Caller must hold ip->lock.
+// Returns 0 if out of memory or the read fails.
+char*
+textget(struct inode *ip, uint64 off, uint n)
+{
+  struct textpage *t;
+  char *mem;
+
+  acquire(&tcache.lock);
+  for(t = *bucket(ip->dev, ip->inum); t; t = t->next){
+    if(t->inum == ip->inum && t->dev == ip->dev && t->off == off && t->n == n){
+      kdup(t->pa);
+      release(&tcache.lock);
+      return t->pa;
+    }
+  }
+  release(&tcache.lock);
+
+  // not cached. no one else can read this page in
+  // meanwhile, since we hold ip->lock.
+  if((mem = kalloc()) == 0)
+    return 0;
+  memset(mem, 0, PGSIZE);
+  if(readi(ip, 0, (uint64)mem, off, n) != n){
+    kfree(mem);
+    return 0;
+  }
+
+  acquire(&tcache.lock);
+  for(t = tcache.page; t < &tcache.page[NTEXT]; t++){
+    if(t->pa == 0)
+      break;
+  }
+  if(t == &tcache.page[NTEXT]){
+    // full: evict round-robin. mappings of the page keep it.
+    t = &tcache.page[tcache.hand];
+    tcache.hand = (tcache.hand + 1) % NTEXT;
+    textdrop(t);
+  }
+  t->dev = ip->dev;
+  t->inum = ip->inum;
+  t->off = off;
+  t->n = n;
+  t->pa = mem;
+  kdup(mem);
+  t->next = *bucket(ip->dev, ip->inum);
+  *bucket(ip->dev, ip->inum) = t;
+  release(&tcache.lock);
+  return mem;
+}
+
+// ip's contents are about to change: forget its pages.
+// Caller must hold ip->lock.
+void
+textinval(struct inode *ip)
+{
+  struct textpage *t, *next;
+
+  acquire(&tcache.lock);
+  for(t = *bucket(ip->dev, ip->inum); t; t = next){
+    next = t->next;
+    if(t->inum == ip->inum && t->dev == ip->dev)
+      textdrop(t);
+  }
+  release(&tcache.lock);
+}
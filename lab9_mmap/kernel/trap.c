@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "fcntl.h"
 
 struct spinlock tickslock;
 uint ticks;
@@ -15,6 +16,7 @@ extern char trampoline[], uservec[], userret[];
 void kernelvec();
 
 extern int devintr();
+static int faultaccess(uint64);
 
 void
 trapinit(void)
@@ -67,6 +69,9 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if(faultaccess(r_scause()) &&
+            vmafault(p, r_stval(), faultaccess(r_scause())) == 0){
+    // a page of an mmap()ed region, now filled in.
   } else {
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", r_scause(), p->pid);
     printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
@@ -176,6 +181,22 @@ clockintr()
   w_stimecmp(r_time() + 1000000);
 }
 
+// if scause is a page fault, the PROT_* access
+// that faulted; otherwise 0.
+static int
+faultaccess(uint64 scause)
+{
+  switch(scause){
+  case 12:
+    return PROT_EXEC;   // instruction page fault
+  case 13:
+    return PROT_READ;   // load page fault
+  case 15:
+    return PROT_WRITE;  // store/AMO page fault
+  }
+  return 0;
+}
+
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
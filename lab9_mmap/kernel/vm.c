@@ -5,6 +5,9 @@
 #include "riscv.h"
 #include "defs.h"
 #include "fs.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fcntl.h"
 
 /*
  * the kernel's page table.
@@ -304,29 +307,35 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 }
 
 // Given a parent process's page table, copy
-// its memory into a child's page table.
+// its memory from base to sz into a child's page table.
 // Copies both the page table and the
-// physical memory.
+// physical memory. Read-only pages are shared
+// rather than copied.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
-uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+uvmcopy(pagetable_t old, pagetable_t new, uint64 base, uint64 sz)
 {
   pte_t *pte;
   uint64 pa, i;
   uint flags;
   char *mem;
 
-  for(i = 0; i < sz; i += PGSIZE){
+  for(i = base; i < sz; i += PGSIZE){
     if((pte = walk(old, i, 0)) == 0)
       panic("uvmcopy: pte should exist");
     if((*pte & PTE_V) == 0)
       panic("uvmcopy: page not present");
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if((flags & PTE_W) == 0){
+      mem = (char*)pa;
+      kdup(mem);
+    } else if((mem = kalloc()) == 0){
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
+    } else {
+      memmove(mem, (char*)pa, PGSIZE);
+    }
     if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
       kfree(mem);
       goto err;
@@ -335,7 +344,7 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
   return 0;
 
  err:
-  uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmunmap(new, base, (i - base) / PGSIZE, 1);
   return -1;
 }
 
@@ -352,6 +361,39 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
+// Like walk(), but if va is a not-yet-present page of one of
+// the current process's mmap()ed regions, fault it in first,
+// so that system calls can use mapped memory directly.
+// Filling the page may sleep reading the file, so a caller
+// that copies while holding a spinlock (e.g. piperead())
+// must vmaprefault() the range before taking the lock.
+static pte_t *
+lazywalk(pagetable_t pagetable, uint64 va, int access)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    return 0;
+  pte = walk(pagetable, va, 0);
+  if((pte == 0 || (*pte & PTE_V) == 0) && p != 0 &&
+     p->pagetable == pagetable && vmafault(p, va, access) == 0)
+    pte = walk(pagetable, va, 0);
+  return pte;
+}
+
+// walkaddr() for copyin(), faulting in mapped pages.
+static uint64
+lazywalkaddr(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+
+  pte = lazywalk(pagetable, va, PROT_READ);
+  if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0)
+    return 0;
+  return PTE2PA(*pte);
+}
+
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
@@ -365,10 +407,13 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
     va0 = PGROUNDDOWN(dstva);
     if(va0 >= MAXVA)
       return -1;
-    pte = walk(pagetable, va0, 0);
+    pte = lazywalk(pagetable, va0, PROT_WRITE);
     if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 ||
        (*pte & PTE_W) == 0)
       return -1;
+    // the store goes through the kernel's direct mapping,
+    // which doesn't set the user PTE's dirty bit.
+    *pte |= PTE_A | PTE_D;
     pa0 = PTE2PA(*pte);
     n = PGSIZE - (dstva - va0);
     if(n > len)
@@ -392,7 +437,7 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = lazywalkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -419,7 +464,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = lazywalkaddr(pagetable, va0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -0,0 +1,772 @@
+//
+// Memory-mapped files: the per-process regions behind
+// mmap(), munmap(), msync() and madvise(), and exec()'s
+// program segments, and the page-fault path that fills
+// them in from the backing inode.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+// p's regions 0..nvma are kept sorted by address, with no two
+// regions overlapping, so that a lookup is a binary search.
+// Adjacent regions that map consecutive bytes of the same
+// file the same way are merged, which keeps the table short
+// for programs that map a file a chunk at a time.
+//
+// The table lives in pages that are allocated as it grows,
+// VMAPERPAGE regions to a page, so that a process with few
+// regions costs little; p->vma[] points to them.
+
+#define VMAPERPAGE (PGSIZE / sizeof(struct vma))
+
+// Region i of p.
+#define VMA(p, i) (&(p)->vma[(i) / VMAPERPAGE][(i) % VMAPERPAGE])
+
+// Index of the first region of p that ends above va, or
+// p->nvma if there is none.
+static int
+vmaindex(struct proc *p, uint64 va)
+{
+  int lo = 0, hi = p->nvma, mid;
+
+  while(lo < hi){
+    mid = (lo + hi) / 2;
+    if(VMA(p, mid)->addr + VMA(p, mid)->len <= va)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Return the region of p that contains va, or 0.
+struct vma*
+vmalookup(struct proc *p, uint64 va)
+{
+  struct vma *v;
+  int i;
+
+  // successive faults mostly land in the same region.
+  if(p->vmahint < p->nvma){
+    v = VMA(p, p->vmahint);
+    if(va >= v->addr && va < v->addr + v->len)
+      return v;
+  }
+
+  i = vmaindex(p, va);
+  if(i == p->nvma || va < VMA(p, i)->addr)
+    return 0;
+  p->vmahint = i;
+  return VMA(p, i);
+}
+
+// Does any region of p overlap [start, end)?
+int
+vmaoverlap(struct proc *p, uint64 start, uint64 end)
+{
+  int i = vmaindex(p, start);
+
+  return i < p->nvma && VMA(p, i)->addr < end;
+}
+
+// Is every page of [start, end) in some region of p?
+static int
+vmacovered(struct proc *p, uint64 start, uint64 end)
+{
+  int i;
+
+  for(i = vmaindex(p, start); start < end; i++){
+    if(i == p->nvma || VMA(p, i)->addr > start)
+      return 0;
+    start = VMA(p, i)->addr + VMA(p, i)->len;
+  }
+  return 1;
+}
+
+// PTE permission bits for a region's PROT_* bits.
+static int
+vmaperm(int prot)
+{
+  int perm = PTE_U;
+
+  // risc-v has no write-only pages.
+  if(prot & (PROT_READ | PROT_WRITE))
+    perm |= PTE_R;
+  if(prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(prot & PROT_EXEC)
+    perm |= PTE_X;
+  return perm;
+}
+
+// Can b, which lies above a, be folded into a?
+static int
+vmamergeable(struct vma *a, struct vma *b)
+{
+  return a->addr + a->len == b->addr && a->ip == b->ip &&
+    a->off + a->len == b->off && a->filesz == a->len &&
+    a->prot == b->prot && a->flags == b->flags &&
+    a->advice == b->advice && a->text == b->text;
+}
+
+// Pick an address for a new region of len bytes mapping ip
+// from offset off. Prefer the space just above a region that
+// maps the bytes of ip before off, so that the two merge;
+// otherwise take the top of the highest gap below MMAPTOP,
+// above the heap, that is big enough, which merges with the
+// region above if that maps the bytes after.
+// Returns 0 if there is no room.
+static uint64
+vmaplace(struct proc *p, uint64 len, int prot, int flags,
+         struct inode *ip, uint64 off)
+{
+  struct vma *v, nv;
+  uint64 top, bot, heap = PGROUNDUP(p->sz);
+  int i;
+
+  for(i = 0; i < p->nvma; i++){
+    v = VMA(p, i);
+    nv.addr = v->addr + v->len;
+    nv.len = len;
+    nv.prot = prot;
+    nv.flags = flags;
+    nv.advice = MADV_NORMAL;
+    nv.ip = ip;
+    nv.off = off;
+    nv.filesz = len;
+    top = i + 1 < p->nvma ? VMA(p, i+1)->addr : MMAPTOP;
+    if(nv.addr >= heap && nv.addr + len <= top && nv.addr + len > nv.addr &&
+       vmamergeable(v, &nv))
+      return nv.addr;
+  }
+
+  top = MMAPTOP;
+  for(i = p->nvma - 1; ; i--){
+    bot = i >= 0 ? VMA(p, i)->addr + VMA(p, i)->len : 0;
+    if(bot < heap)
+      bot = heap;
+    if(top >= bot && top - bot >= len)
+      return top - len;
+    if(i < 0 || VMA(p, i)->addr <= heap)
+      return 0;
+    top = VMA(p, i)->addr;
+  }
+}
+
+// Make sure p's table has pages for n regions.
+// Returns 0 on success, -1 if n is too many or memory is short.
+int
+vmareserve(struct proc *p, int n)
+{
+  int i;
+
+  if(n > NVMA)
+    return -1;
+  for(i = 0; i * VMAPERPAGE < n; i++){
+    if(p->vma[i] == 0 && (p->vma[i] = (struct vma*)kalloc()) == 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Free the pages of p's table, which must hold no regions.
+void
+vmatabfree(struct proc *p)
+{
+  int i;
+
+  for(i = 0; i < NELEM(p->vma); i++){
+    if(p->vma[i])
+      kfree(p->vma[i]);
+    p->vma[i] = 0;
+  }
+}
+
+// Move n regions of p from index from to index to; the
+// ranges may overlap.
+static void
+vmamove(struct proc *p, int to, int from, int n)
+{
+  int k;
+
+  if(to < from){
+    for(k = 0; k < n; k++)
+      *VMA(p, to + k) = *VMA(p, from + k);
+  } else {
+    for(k = n - 1; k >= 0; k--)
+      *VMA(p, to + k) = *VMA(p, from + k);
+  }
+}
+
+// Open a slot for a new region at index i of p.
+// Returns 0 on success, -1 if the table is full or memory is short.
+static int
+vmainsert(struct proc *p, int i)
+{
+  if(vmareserve(p, p->nvma + 1) < 0)
+    return -1;
+  vmamove(p, i + 1, i, p->nvma - i);
+  p->nvma++;
+  return 0;
+}
+
+// Drop region i of p, and its reference to its file.
+static void
+vmaremove(struct proc *p, int i)
+{
+  struct inode *ip = VMA(p, i)->ip;
+
+  if(VMA(p, i)->text)
+    itext(ip, -1);
+  vmamove(p, i, i + 1, p->nvma - i - 1);
+  p->nvma--;
+  begin_op();
+  iput(ip);
+  end_op();
+}
+
+// Fold region i+1 of p into region i if they are adjacent
+// pieces of one mapping.
+static void
+vmamerge(struct proc *p, int i)
+{
+  if(i < 0 || i + 1 >= p->nvma || !vmamergeable(VMA(p, i), VMA(p, i+1)))
+    return;
+  VMA(p, i)->len += VMA(p, i+1)->len;
+  VMA(p, i)->filesz += VMA(p, i+1)->filesz;
+  // the inode stays referenced by region i.
+  vmaremove(p, i + 1);
+}
+
+// Make va a boundary between regions of p, splitting the
+// region that straddles it, if any, in two.
+// Returns 0 on success, -1 if the table is full or memory is short.
+static int
+vmasplit(struct proc *p, uint64 va)
+{
+  struct vma *v;
+  uint64 n;
+  int i = vmaindex(p, va);
+
+  if(i == p->nvma || VMA(p, i)->addr >= va)
+    return 0;
+  if(vmainsert(p, i) < 0)
+    return -1;
+
+  v = VMA(p, i+1);
+  n = va - v->addr;
+  VMA(p, i)->len = n;
+  if(VMA(p, i)->filesz > n)
+    VMA(p, i)->filesz = n;
+  v->off += n;
+  v->len -= n;
+  v->filesz = v->filesz > n ? v->filesz - n : 0;
+  v->addr = va;
+  idup(v->ip);
+  if(v->text)
+    itext(v->ip, 1);
+  return 0;
+}
+
+// Set up a region of len bytes mapping ip from offset off.
+// Nothing is read until the pages are touched. The region
+// takes its own reference to ip.
+// Returns the region's address, or -1.
+uint64
+vmacreate(struct proc *p, uint64 len, int prot, int flags,
+          struct inode *ip, uint64 off)
+{
+  struct vma *v;
+  uint64 addr;
+  int i;
+
+  if(len == 0 || len > MMAPTOP)
+    return -1;
+  len = PGROUNDUP(len);
+
+  if((addr = vmaplace(p, len, prot, flags, ip, off)) == 0)
+    return -1;
+
+  i = vmaindex(p, addr);
+  if(vmainsert(p, i) < 0)
+    return -1;
+  v = VMA(p, i);
+  v->addr = addr;
+  v->len = len;
+  v->prot = prot;
+  v->flags = flags;
+  v->advice = MADV_NORMAL;
+  v->ip = idup(ip);
+  v->off = off;
+  v->filesz = len;
+  v->text = 0;
+
+  vmamerge(p, i);
+  vmamerge(p, i - 1);
+  return addr;
+}
+
+// Set up a program segment for exec(): [addr, addr+len) holds
+// filesz bytes of ip from offset off, then zeros. The pages are
+// read in as the program touches them. p must have no other
+// regions in the way, and room for this one (see vmareserve()).
+void
+vmasegment(struct proc *p, uint64 addr, uint64 len, int prot,
+           struct inode *ip, uint64 off, uint64 filesz)
+{
+  struct vma *v;
+  int i;
+
+  len = PGROUNDUP(len);
+  i = vmaindex(p, addr);
+  if(vmainsert(p, i) < 0)
+    panic("vmasegment");
+  v = VMA(p, i);
+  v->addr = addr;
+  v->len = len;
+  v->prot = prot;
+  v->flags = MAP_PRIVATE;
+  v->advice = MADV_NORMAL;
+  v->ip = idup(ip);
+  v->off = off;
+  v->filesz = filesz;
+  v->text = 1;
+  itext(ip, 1);
+}
+
+// Make the page at a, which lies in v, present, reading its
+// contents from the backing file; bytes past v->filesz or
+// the end of the file read as zero. flags are extra PTE bits (PTE_A, PTE_D)
+// for a page that is being accessed right now.
+// Caller must hold v->ip->lock.
+// Returns 0 on success, -1 if out of memory.
+static int
+vmapage(struct proc *p, struct vma *v, uint64 a, int flags)
+{
+  pte_t *pte;
+  char *mem;
+  uint64 n = v->filesz > a - v->addr ? v->filesz - (a - v->addr) : 0;
+  uint64 off = v->off + (a - v->addr);
+
+  if((pte = walk(p->pagetable, a, 0)) != 0 && (*pte & PTE_V))
+    return 0;
+
+  if(n > PGSIZE)
+    n = PGSIZE;
+  if(n > 0 && off >= v->ip->size)
+    n = 0;
+  else if(n > 0 && n > v->ip->size - off)
+    n = v->ip->size - off;
+
+  if(v->flags == MAP_PRIVATE && (v->prot & PROT_WRITE) == 0 && n > 0){
+    // nothing will ever store to the page: share one
+    // copy with every other mapping of these bytes.
+    if((mem = textget(v->ip, off, n)) == 0)
+      return -1;
+  } else {
+    if((mem = kalloc()) == 0)
+      return -1;
+    memset(mem, 0, PGSIZE);
+    if(n > 0 && readi(v->ip, 0, (uint64)mem, off, n) < 0){
+      kfree(mem);
+      return -1;
+    }
+  }
+  if(mappages(p->pagetable, a, PGSIZE, (uint64)mem, vmaperm(v->prot) | flags) != 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Make va present, and opportunistically the other pages of v
+// in [start, end) that hold file data, all under one ilock().
+// Zero-fill pages, such as a program's bss, wait for a touch.
+// Neighbours are skipped rather than failing the fault if
+// memory runs short. flags are passed to vmapage() for va.
+// Returns 0 if va is now present, -1 if not.
+static int
+vmafill(struct proc *p, struct vma *v, uint64 va, uint64 start, uint64 end,
+        int flags)
+{
+  uint64 a;
+  int r;
+
+  // a page of zeros, such as a program's bss, needs
+  // nothing from the file.
+  if(va - v->addr >= v->filesz)
+    return vmapage(p, v, va, flags);
+
+  // a copyout() from inside readi() of this same file,
+  // e.g. read(fd, p, n) into a mapping of fd; ilock()
+  // would deadlock.
+  if(holdingsleep(&v->ip->lock))
+    return -1;
+
+  ilock(v->ip);
+  r = vmapage(p, v, va, flags);
+  if(r == 0){
+    for(a = start; a < end; a += PGSIZE){
+      if(a == va || a - v->addr >= v->filesz ||
+         v->off + (a - v->addr) >= v->ip->size)
+        continue;
+      if(vmapage(p, v, a, 0) < 0)
+        break;
+    }
+  }
+  iunlock(v->ip);
+  return r;
+}
+
+// Handle a page fault at va needing access (PROT_READ,
+// PROT_WRITE or PROT_EXEC). If a region of p covers va and
+// permits the access, map the page together with up to
+// FAULTAROUND neighbours (READAHEAD pages ahead under
+// MADV_SEQUENTIAL), so that a pass over a mapped file
+// costs a fraction of a trap per page.
+// Returns 0 on success, -1 if the access is illegal or
+// memory is exhausted.
+int
+vmafault(struct proc *p, uint64 va, int access)
+{
+  struct vma *v;
+  uint64 start, end, n;
+  pte_t *pte;
+  int flags;
+
+  if(va >= MAXVA)
+    return -1;
+  va = PGROUNDDOWN(va);
+  if((v = vmalookup(p, va)) == 0 || (v->prot & access) != access)
+    return -1;
+
+  flags = PTE_A | (access == PROT_WRITE ? PTE_D : 0);
+  if((pte = walk(p->pagetable, va, 0)) != 0 && (*pte & PTE_V)){
+    // present already: a hart that leaves PTE_A and PTE_D
+    // to software (Svade) traps on the first access, or
+    // the first store, to a page.
+    *pte |= flags;
+    return 0;
+  }
+
+  if(v->advice == MADV_SEQUENTIAL){
+    start = va;
+    n = READAHEAD;
+  } else {
+    // the naturally aligned window around va.
+    n = v->advice == MADV_RANDOM ? 1 : FAULTAROUND;
+    start = va - ((va - v->addr) / PGSIZE % n) * PGSIZE;
+  }
+  end = start + n*PGSIZE;
+  if(end > v->addr + v->len)
+    end = v->addr + v->len;
+
+  return vmafill(p, v, va, start, end, flags);
+}
+
+// Fault in whatever pages of p's regions in [addr, addr+n)
+// are not present yet, for a caller about to copy to them
+// (access PROT_WRITE) or from them (PROT_READ) while holding
+// a spinlock, where vmafault() can't run since it may sleep.
+// A page that can't be faulted in is left for the copy to
+// refuse.
+void
+vmaprefault(struct proc *p, uint64 addr, uint64 n, int access)
+{
+  pte_t *pte;
+  uint64 a, end = addr + n;
+
+  if(end < addr || end > MAXVA)
+    end = MAXVA;
+  for(a = PGROUNDDOWN(addr); a < end; a += PGSIZE){
+    if(vmalookup(p, a) == 0)
+      continue;
+    if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+      vmafault(p, a, access);
+  }
+}
+
+// Write the dirty pages of v in [start, end) back to the file
+// and mark them clean, if v is a writable MAP_SHARED region.
+// A page stays dirty unless all of it reached the file.
+// Only pages with PTE_D set have been stored to since they were
+// read in or last written back. Consecutive dirty pages share
+// log transactions, as many blocks per transaction as the log
+// allows. The file never grows: bytes mapped past its end were
+// zero-fill.
+// Returns 0, or -1 if some page could not be written.
+static int
+vmawriteback(struct proc *p, struct vma *v, uint64 start, uint64 end)
+{
+  // a transaction logs the inode once plus the data blocks;
+  // the pages lie within the file, so bmap() allocates
+  // nothing. keep one block of slop.
+  int budget = MAXOPBLOCKS - 2;
+  int open = 0, used = 0, n, i, ok, r = 0;
+  uint64 a, pa, off;
+  pte_t *pte;
+
+  if((v->flags & MAP_SHARED) == 0 || (v->prot & PROT_WRITE) == 0)
+    return 0;
+
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0 ||
+       (*pte & PTE_D) == 0)
+      continue;
+    pa = PTE2PA(*pte);
+    off = v->off + (a - v->addr);
+    ok = 1;
+    for(i = 0; i < PGSIZE; i += n){
+      if(!open){
+        begin_op();
+        ilock(v->ip);
+        open = 1;
+        used = 0;
+      }
+      if(off + i >= v->ip->size)
+        break;
+      n = PGSIZE - i;
+      if(n > (budget - used) * BSIZE)
+        n = (budget - used) * BSIZE;
+      if(off + i + n > v->ip->size)
+        n = v->ip->size - (off + i);
+      if(writei(v->ip, 0, pa + i, off + i, n) != n){
+        ok = 0;
+        break;
+      }
+      used += (n + BSIZE - 1) / BSIZE;
+      if(used >= budget){
+        iunlock(v->ip);
+        end_op();
+        open = 0;
+      }
+    }
+    // the trampoline flushes the TLB on the way back to user
+    // space, so the next store will set PTE_D again.
+    if(ok)
+      *pte &= ~PTE_D;
+    else
+      r = -1;
+  }
+  if(open){
+    iunlock(v->ip);
+    end_op();
+  }
+  return r;
+}
+
+// Unmap and free whatever pages are present in [start, end).
+static void
+vmazap(pagetable_t pagetable, uint64 start, uint64 end)
+{
+  pte_t *pte;
+  uint64 a;
+
+  for(a = start; a < end; a += PGSIZE){
+    if((pte = walk(pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+      continue;
+    kfree((void*)PTE2PA(*pte));
+    *pte = 0;
+  }
+}
+
+// Remove [addr, addr+len) from p's address space, writing
+// dirty MAP_SHARED pages back first. Regions that straddle
+// either end of the range are split.
+// Returns 0 on success, -1 on error or if nothing in the
+// range is mapped. If a write-back fails, nothing is unmapped.
+int
+vmaunmap(struct proc *p, uint64 addr, uint64 len)
+{
+  struct vma *v;
+  uint64 end;
+  int i;
+
+  if(addr % PGSIZE != 0 || len == 0)
+    return -1;
+  end = PGROUNDUP(addr + len);
+  if(end <= addr || end > MAXVA || !vmaoverlap(p, addr, end))
+    return -1;
+  if(vmasplit(p, addr) < 0 || vmasplit(p, end) < 0)
+    return -1;
+
+  for(i = vmaindex(p, addr); i < p->nvma && VMA(p, i)->addr < end; i++){
+    v = VMA(p, i);
+    if(vmawriteback(p, v, v->addr, v->addr + v->len) < 0)
+      return -1;
+  }
+  i = vmaindex(p, addr);
+  while(i < p->nvma && VMA(p, i)->addr < end){
+    v = VMA(p, i);
+    vmazap(p->pagetable, v->addr, v->addr + v->len);
+    vmaremove(p, i);
+  }
+  return 0;
+}
+
+// Apply an madvise() hint to [addr, addr+len), which must
+// be mapped throughout. An access-pattern hint splits
+// regions as needed so that it covers exactly the range.
+// Returns 0 on success, -1 on error.
+int
+vmaadvise(struct proc *p, uint64 addr, uint64 len, int advice)
+{
+  struct vma *v;
+  uint64 end, s, e;
+  int i, j;
+
+  if(addr % PGSIZE != 0 || advice < MADV_NORMAL || advice > MADV_DONTNEED)
+    return -1;
+  end = PGROUNDUP(addr + len);
+  if(end < addr || !vmacovered(p, addr, end))
+    return -1;
+  if(end == addr)
+    return 0;
+
+  switch(advice){
+  case MADV_NORMAL:
+  case MADV_RANDOM:
+  case MADV_SEQUENTIAL:
+    if(vmasplit(p, addr) < 0 || vmasplit(p, end) < 0)
+      return -1;
+    i = vmaindex(p, addr);
+    for(j = i; j < p->nvma && VMA(p, j)->addr < end; j++)
+      VMA(p, j)->advice = advice;
+    // rejoin pieces that now agree, from the top down so
+    // that the indices below stay put.
+    for(j--; j >= i - 1; j--)
+      vmamerge(p, j);
+    return 0;
+  case MADV_WILLNEED:
+    // read the file data in now rather than a fault at a time.
+    for(i = vmaindex(p, addr); i < p->nvma && VMA(p, i)->addr < end; i++){
+      v = VMA(p, i);
+      s = addr > v->addr ? addr : v->addr;
+      e = end < v->addr + v->len ? end : v->addr + v->len;
+      if(v->prot != PROT_NONE && vmafill(p, v, s, s, e, 0) < 0)
+        return -1;
+    }
+    return 0;
+  case MADV_DONTNEED:
+    // shared pages go back to the file; private changes are
+    // discarded, and the next touch re-reads the file.
+    for(i = vmaindex(p, addr); i < p->nvma && VMA(p, i)->addr < end; i++){
+      v = VMA(p, i);
+      s = addr > v->addr ? addr : v->addr;
+      e = end < v->addr + v->len ? end : v->addr + v->len;
+      // keep the pages if their data can't be saved.
+      if(vmawriteback(p, v, s, e) < 0)
+        return -1;
+      vmazap(p->pagetable, s, e);
+    }
+    return 0;
+  }
+  return -1;
+}
+
+// msync(): write the dirty pages of [addr, addr+len), which
+// must be mapped throughout, back to the file now.
+// Every write is synchronous in xv6, so MS_ASYNC and
+// MS_SYNC behave alike.
+// Returns 0 on success, -1 on error.
+int
+vmasync(struct proc *p, uint64 addr, uint64 len, int flags)
+{
+  struct vma *v;
+  uint64 end, s, e;
+  int i, r = 0;
+
+  if(addr % PGSIZE != 0 || (flags & ~(MS_ASYNC | MS_SYNC)) != 0)
+    return -1;
+  end = PGROUNDUP(addr + len);
+  if(end < addr || !vmacovered(p, addr, end))
+    return -1;
+
+  for(i = vmaindex(p, addr); i < p->nvma && VMA(p, i)->addr < end; i++){
+    v = VMA(p, i);
+    s = addr > v->addr ? addr : v->addr;
+    e = end < v->addr + v->len ? end : v->addr + v->len;
+    if(vmawriteback(p, v, s, e) < 0)
+      r = -1;
+  }
+  return r;
+}
+
+// Give child np a copy of p's regions, including exec()'s
+// segments, for fork(). Pages already present are copied,
+// clean, so that the child writes back only its own stores,
+// or shared if read-only; the rest will fault in from the file.
+// Returns 0 on success, -1 (with nothing copied) on failure.
+int
+vmacopy(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint64 a;
+  char *mem;
+  int i;
+
+  if(vmareserve(np, p->nvma) < 0)
+    return -1;
+  for(i = 0; i < p->nvma; i++){
+    v = VMA(p, i);
+    for(a = v->addr; a < v->addr + v->len; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+        continue;
+      if((*pte & PTE_W) == 0){
+        mem = (char*)PTE2PA(*pte);
+        kdup(mem);
+      } else if((mem = kalloc()) == 0){
+        goto err;
+      } else {
+        memmove(mem, (char*)PTE2PA(*pte), PGSIZE);
+      }
+      if(mappages(np->pagetable, a, PGSIZE, (uint64)mem,
+                  PTE_FLAGS(*pte) & ~PTE_D) != 0){
+        kfree(mem);
+        goto err;
+      }
+    }
+  }
+
+  for(i = 0; i < p->nvma; i++){
+    *VMA(np, i) = *VMA(p, i);
+    idup(VMA(np, i)->ip);
+    if(VMA(np, i)->text)
+      itext(VMA(np, i)->ip, 1);
+  }
+  np->nvma = p->nvma;
+  np->vmahint = 0;
+  return 0;
+
+ err:
+  for(i = 0; i < p->nvma; i++)
+    vmazap(np->pagetable, VMA(p, i)->addr, VMA(p, i)->addr + VMA(p, i)->len);
+  return -1;
+}
+
+// Write back the dirty pages of, and tear down, all of p's regions,
+// as at exit() or exec().
+void
+vmafree(struct proc *p)
+{
+  struct vma *v;
+
+  while(p->nvma > 0){
+    v = VMA(p, p->nvma - 1);
+    vmawriteback(p, v, v->addr, v->addr + v->len);
+    vmazap(p->pagetable, v->addr, v->addr + v->len);
+    vmaremove(p, p->nvma - 1);
+  }
+  p->vmahint = 0;
+}
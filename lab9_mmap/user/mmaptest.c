@@ -9,6 +9,9 @@
 void mmap_test();
 void fork_test();
 void more_test();
+void madvise_test();
+void msync_test();
+void many_test();
 char buf[PGSIZE];
 
 #define MAP_FAILED ((char *) -1)
@@ -19,6 +22,9 @@ main(int argc, char *argv[])
   mmap_test();
   fork_test();
   more_test();
+  madvise_test();
+  msync_test();
+  many_test();
   printf("mmaptest: all tests succeeded\n");
   exit(0);
 }
@@ -125,6 +131,18 @@ mmap_test(void)
     err("mmap (2)");
   if (close(fd) == -1)
     err("close (1)");
+  // a pipe's bytes are copied out under its lock; the kernel
+  // must fault the untouched page in before taking it.
+  int fds[2];
+  if (pipe(fds) == -1)
+    err("pipe");
+  if (write(fds[1], "xy", 2) != 2)
+    err("write pipe");
+  if (read(fds[0], p, 2) != 2 || p[0] != 'x' || p[1] != 'y')
+    err("read pipe into mapping");
+  close(fds[0]);
+  close(fds[1]);
+  p[0] = p[1] = 'A';
   _v1(p);
   for (i = 0; i < PGSIZE*2; i++)
     p[i] = 'Z';
@@ -446,3 +464,171 @@ more_test()
 
   printf("test writes to read-only mapped memory: OK\n");
 }
+
+//
+// check that madvise() hints leave the mapped contents
+// right: SEQUENTIAL and WILLNEED only change how pages
+// are read in; DONTNEED discards a private mapping's
+// changes but writes a shared mapping's back first.
+//
+void
+madvise_test(void)
+{
+  int fd, i;
+  char *p;
+  const char * const f = "mmap.dur";
+
+  printf("test madvise\n");
+
+  makefile(f);
+  if ((fd = open(f, O_RDWR)) == -1)
+    err("open");
+
+  p = mmap(0, PGSIZE*2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+    err("mmap (9)");
+  if (madvise(p, PGSIZE*2, MADV_SEQUENTIAL) == -1)
+    err("madvise sequential");
+  _v1(p);
+  for (i = 0; i < PGSIZE; i++)
+    p[i] = 'Z';
+  if (madvise(p, PGSIZE, MADV_DONTNEED) == -1)
+    err("madvise dontneed (1)");
+  // the private change is gone; the file's data is back.
+  _v1(p);
+  if (munmap(p, PGSIZE*2) == -1)
+    err("munmap (8)");
+
+  p = mmap(0, PGSIZE*2, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    err("mmap (10)");
+  if (madvise(p, PGSIZE*2, MADV_WILLNEED) == -1)
+    err("madvise willneed");
+  _v1(p);
+  p[0] = 'W';
+  if (madvise(p, PGSIZE, MADV_DONTNEED) == -1)
+    err("madvise dontneed (2)");
+  if (p[0] != 'W')
+    err("MADV_DONTNEED lost a shared write");
+  if (madvise(p + PGSIZE*2, PGSIZE, MADV_WILLNEED) != -1)
+    err("madvise outside mapping");
+  if (munmap(p, PGSIZE*2) == -1)
+    err("munmap (9)");
+  if (close(fd) == -1)
+    err("close (7)");
+
+  printf("test madvise: OK\n");
+}
+
+//
+// check that msync() writes a shared mapping's stores back
+// while it is still mapped, and that a page left clean since
+// is not written back again by munmap().
+//
+void
+msync_test(void)
+{
+  int fd, fd1;
+  char *p;
+  const char * const f = "mmap.dur";
+
+  printf("test msync\n");
+
+  makefile(f);
+  if ((fd = open(f, O_RDWR)) == -1)
+    err("open");
+  p = mmap(0, PGSIZE*2, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    err("mmap (11)");
+  close(fd);
+
+  p[0] = 'S';
+  p[PGSIZE] = 'T';
+  if (msync(p, PGSIZE*2, MS_SYNC) == -1)
+    err("msync");
+
+  if ((fd1 = open(f, O_RDONLY)) == -1)
+    err("open");
+  if (read(fd1, buf, PGSIZE) != PGSIZE || buf[0] != 'S')
+    err("msync did not write page 0");
+  if (read(fd1, buf, PGSIZE) != PGSIZE/2 || buf[0] != 'T')
+    err("msync did not write page 1");
+  close(fd1);
+
+  // overwrite the file behind the mapping's back; the
+  // mapped copy is clean, so munmap() must leave this be.
+  if ((fd1 = open(f, O_WRONLY)) == -1)
+    err("open");
+  if (write(fd1, "U", 1) != 1)
+    err("write");
+  close(fd1);
+
+  if (munmap(p, PGSIZE*2) == -1)
+    err("munmap (10)");
+
+  if ((fd1 = open(f, O_RDONLY)) == -1)
+    err("open");
+  if (read(fd1, buf, PGSIZE) != PGSIZE || buf[0] != 'U')
+    err("munmap wrote back a clean page");
+  close(fd1);
+
+  printf("test msync: OK\n");
+}
+
+//
+// check that a file mapped a page at a time, back to front,
+// ends up as one contiguous mapping that munmap() can punch
+// holes in, and that many separate mappings all stay
+// reachable.
+//
+void
+many_test(void)
+{
+  int fd, i;
+  char *p, *q, *r[100];
+  const char * const f = "mmap.dur";
+  const int n = 300;
+
+  printf("test many mappings\n");
+
+  makefile(f);
+  if ((fd = open(f, O_RDONLY)) == -1)
+    err("open");
+
+  // more chunks than a process has regions: they have to merge.
+  q = mmap(0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, (n-1)*PGSIZE);
+  if (q == MAP_FAILED)
+    err("mmap (12)");
+  for (i = n-2; i >= 0; i--) {
+    p = mmap(0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, i*PGSIZE);
+    if (p == MAP_FAILED)
+      err("mmap (13)");
+    if (p != q - (n-1-i)*PGSIZE)
+      err("consecutive chunks not placed contiguously");
+  }
+  _v1(p);
+  if (p[n*PGSIZE-1] != 0)
+    err("past end of file not zero");
+  if (munmap(p + PGSIZE*10, PGSIZE) == -1)
+    err("munmap (11)");
+  if (p[PGSIZE*9] != 0 || p[PGSIZE*11] != 0)
+    err("neighbours of a hole");
+  if (munmap(p, n*PGSIZE) == -1)
+    err("munmap (12)");
+
+  for (i = 0; i < 100; i++) {
+    r[i] = mmap(0, PGSIZE*2, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (r[i] == MAP_FAILED)
+      err("mmap (14)");
+  }
+  for (i = 0; i < 100; i++)
+    _v1(r[i]);
+  for (i = 0; i < 100; i++) {
+    if (munmap(r[i], PGSIZE*2) == -1)
+      err("munmap (13)");
+  }
+  if (close(fd) == -1)
+    err("close (8)");
+
+  printf("test many mappings: OK\n");
+}
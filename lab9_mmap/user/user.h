@@ -26,6 +26,12 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+#ifdef LAB_MMAP
+void *mmap(void *, size_t, int, int, int, off_t);
+int munmap(void *, size_t);
+int madvise(void *, size_t, int);
+int msync(void *, size_t, int);
+#endif
 #ifdef LAB_NET
 int bind(uint16);
 int unbind(uint16);
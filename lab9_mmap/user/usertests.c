@@ -678,6 +678,29 @@ void dirtest(char *s)
   }
 }
 
+// a running program's file can't be written or truncated,
+// since its pages are read in as it touches them.
+void
+textbusy(char *s)
+{
+  char buf[1] = { 0 };
+  int fd;
+
+  if((fd = open("usertests", O_WRONLY)) < 0){
+    printf("%s: open usertests failed\n", s);
+    exit(1);
+  }
+  if(write(fd, buf, 1) != -1){
+    printf("%s: wrote to a running program\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(open("usertests", O_WRONLY|O_TRUNC) >= 0){
+    printf("%s: truncated a running program\n", s);
+    exit(1);
+  }
+}
+
 void
 exectest(char *s)
 {
@@ -2297,6 +2320,45 @@ bsstest(char *s)
   }
 }
 
+// can read() and wait() store into bss pages that were never
+// touched? the kernel copies a pipe's bytes and the exit status
+// while holding a lock, so it must fault the pages in first,
+// and a failed copy must not eat the pipe's bytes.
+char untouched[3*PGSIZE];
+void
+pipebss(char *s)
+{
+  char *a = (char*)PGROUNDUP((uint64)untouched);
+  int fds[2], pid, *xstatus = (int*)(a + PGSIZE);
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(write(fds[1], "hi", 2) != 2){
+    printf("%s: pipe write failed\n", s);
+    exit(1);
+  }
+  if(read(fds[0], a, 2) != 2 || a[0] != 'h' || a[1] != 'i'){
+    printf("%s: pipe read into bss failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0)
+    exit(7);
+  if(wait(xstatus) != pid || *xstatus != 7){
+    printf("%s: wait status into bss failed\n", s);
+    exit(1);
+  }
+}
+
 // does exec return an error if the arguments
 // are larger than a page? or does it write
 // below the stack and wreck the instructions/data?
@@ -2608,6 +2670,7 @@ struct test {
   {createtest, "createtest"},
   {dirtest, "dirtest"},
   {exectest, "exectest"},
+  {textbusy, "textbusy"},
   {pipe1, "pipe1"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
@@ -2641,6 +2704,7 @@ struct test {
   {sbrkarg, "sbrkarg"},
   {validatetest, "validatetest"},
   {bsstest, "bsstest"},
+  {pipebss, "pipebss"},
   {bigargtest, "bigargtest"},
   {argptest, "argptest"},
   {stacktest, "stacktest"},